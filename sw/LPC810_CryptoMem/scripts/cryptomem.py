@@ -6,6 +6,59 @@ import binascii
 
 from Crypto.Hash import SHA256, HMAC
 
+#---------------------------------------------------------------------------------------------------
+# SHA-256 compression function (for midstate calculations)
+#
+SHA256_IV = [
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+]
+
+SHA256_K = [
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+]
+
+def sha256_compress(state, block):
+    """
+    Applies the SHA-256 compression function to one 64-byte block and returns the new chaining value.
+    """
+    def ror(x, n):
+        return ((x >> n) | (x << (32 - n))) & 0xFFFFFFFF
+
+    w = list(struct.unpack(">16I", bytes(block)))
+    for i in range(16, 64):
+        s0 = ror(w[i - 15], 7) ^ ror(w[i - 15], 18) ^ (w[i - 15] >> 3)
+        s1 = ror(w[i - 2], 17) ^ ror(w[i - 2], 19) ^ (w[i - 2] >> 10)
+        w.append((w[i - 16] + s0 + w[i - 7] + s1) & 0xFFFFFFFF)
+
+    (a, b, c, d, e, f, g, h) = state
+    for i in range(64):
+        t1 = (h + (ror(e, 6) ^ ror(e, 11) ^ ror(e, 25)) + ((e & f) ^ (~e & g)) + SHA256_K[i] + w[i]) & 0xFFFFFFFF
+        t2 = ((ror(a, 2) ^ ror(a, 13) ^ ror(a, 22)) + ((a & b) ^ (a & c) ^ (b & c))) & 0xFFFFFFFF
+        (a, b, c, d, e, f, g, h) = ((t1 + t2) & 0xFFFFFFFF, a, b, c, (d + t1) & 0xFFFFFFFF, e, f, g)
+
+    return [(x + y) & 0xFFFFFFFF for (x, y) in zip(state, (a, b, c, d, e, f, g, h))]
+
+def hmac_sha256_key_state(key):
+    """
+    Computes the keyed HMAC-SHA256 state (inner and outer chaining values) of a key. The result
+    uses the same layout as the firmware's Sha256_HmacState_t (16 little-endian 32-bit words).
+    """
+    key = bytes(key)
+    if len(key) > 64:
+        key = SHA256.new(key).digest()
+
+    key   = key + b"\x00" * (64 - len(key))
+    inner = sha256_compress(SHA256_IV, bytes(k ^ 0x36 for k in key))
+    outer = sha256_compress(SHA256_IV, bytes(k ^ 0x5C for k in key))
+    return struct.pack("<16I", *(inner + outer))
+
 #---------------------------------------------------------------------------------------------------
 # I2C device driver interface
 #
@@ -19,11 +72,48 @@ class LPC810_CryptoMem:
           with the standard SMBus class.
 
         i2c_addr: The I2C read address of the device.
+
+        state_cache: Serve pcr(), ctr() and volatile_bits() from a host-side cache that is
+          invalidated when the device state generation changes (requires a firmware build with
+          CONFIG_CRYPTOMEM_STATE_GENERATION).
     """
-    def __init__(self, bus, i2c_addr = 0x20):
+    def __init__(self, bus, i2c_addr = 0x20, state_cache = False, regmap_v2 = False):
         self.bus      = bus
         self.i2c_addr = i2c_addr
 
+        # Register map v2 (device configured with NV_SYS_CFG[7] set)
+        self.regmap_v2 = bool(regmap_v2)
+
+        self.state_cache      = bool(state_cache)
+        self.cache            = {}
+        self.cache_generation = None
+
+    def state_generation(self):
+        """
+        Reads the device state generation register.
+        """
+        return struct.unpack("<I", self.io_read(0x068, 0x04))[0]
+
+    def cached_read(self, offset, length):
+        """
+        Reads from the crypto memory (served from the state cache while the device state generation
+        is unchanged).
+        """
+        if not self.state_cache:
+            return self.io_read(offset, length)
+
+        # Read the generation first (the device updates it after changing its state)
+        generation = self.state_generation()
+        if (generation != self.cache_generation):
+            self.cache            = {}
+            self.cache_generation = generation
+
+        key = (int(offset), int(length))
+        if key not in self.cache:
+            self.cache[key] = self.io_read(offset, length)
+
+        return self.cache[key]
+
     def io_read(self, offset, length):
         """
         Read from the crypto memory
@@ -49,10 +139,8 @@ class LPC810_CryptoMem:
 
     def io_write(self, offset, data):
         """
-        Read from the crypto memory
+        Write to the crypto memory
         """
-        result = []
-
         remaining = len(data)
         data_offset = 0
         offset = int(offset)
@@ -63,9 +151,10 @@ class LPC810_CryptoMem:
             else:
                 to_write = 0x20
 
-            self.bus.write_i2c_block_data(self.i2c_addr, offset, data[data_offset:(data_offset+to_write)])
-            offset    += to_write
-            remaining -= to_write
+            self.bus.write_i2c_block_data(self.i2c_addr, offset, list(data[data_offset:(data_offset+to_write)]))
+            offset      += to_write
+            data_offset += to_write
+            remaining   -= to_write
 
 
     def io_cmd(self, opcode, arg0=0, arg1=0, arg2=0, data=[], rsp_len = 0):
@@ -76,6 +165,9 @@ class LPC810_CryptoMem:
         if len(data) > 0x50:
             raise ValueError("Invalid data paramter size")
 
+        if self.regmap_v2:
+            return self.io_cmd_v2(opcode, arg0, arg1, arg2, data, rsp_len)
+
         # Set the output data
         if (len(data) > 0):
             self.io_write(0x00, bytes(data))
@@ -93,6 +185,70 @@ class LPC810_CryptoMem:
 
         return (rsp[0], rsp[1], bytes(self.io_read(0x00, rsp_len)))
 
+    def io_cmd_v2(self, opcode, arg0=0, arg1=0, arg2=0, data=[], rsp_len = 0):
+        """
+        Execute a command (register map v2; status and response are polled with a single read)
+        """
+
+        # Send the request (DATA, ARG_0-ARG_2 and CMD are contiguous; the data area is zero-padded)
+        request = [int(arg0), int(arg1), int(arg2), int(opcode)]
+
+        if (len(data) > 0):
+            self.io_write(0x00, bytes(data) + bytes(0x50 - len(data)) + bytes(request))
+        else:
+            self.io_write(0x50, request)
+
+        # Poll for the response (STAT, RET_0-RET_2, RSP_LEN, and the response data; reads wrap from 0x57 to 0x00)
+        status = 0xFF
+
+        while (status == 0xFF):
+            rsp = self.io_read(0x53, min(0x05 + rsp_len, 0x20))
+            status = rsp[0]
+
+        # Fetch the rest of the response (SMBus block transfers are limited to 32 bytes)
+        if (len(rsp) < (0x05 + rsp_len)):
+            rsp += self.io_read(len(rsp) - 0x05, 0x05 + rsp_len - len(rsp))
+
+        return (rsp[0], rsp[1], bytes(rsp[5:]))
+
+    def io_cmd_pipelined(self, commands, rsp_len = 0):
+        """
+        Executes a sequence of (opcode, arg0, arg1, data) commands back to back. Each command is
+        uploaded into the staging bank while its predecessor executes and starts automatically
+        (requires a firmware build with CONFIG_CRYPTOMEM_STAGING and the default register map). Returns
+        the result of the last command (like io_cmd).
+        """
+        first = True
+
+        for (opcode, arg0, arg1, data) in commands:
+            if len(data) > 0x50:
+                raise ValueError("Invalid data paramter size")
+
+            if not first:
+                # Wait until the previously staged command has been started
+                while (0 != (self.io_read(0x06C, 0x01)[0] & 0x02)):
+                    pass
+
+                # Stop if the chain has been broken by a failed command
+                rsp = self.io_read(0x54, 0x02)
+                if ((rsp[0] == 0xC3) and (rsp[1] != 0x00)):
+                    raise RuntimeError("remote i2c command failed (0x%02x 0x%02x)" % (rsp[0], rsp[1]))
+
+            if (len(data) > 0):
+                self.io_write(0x00, bytes(data))
+
+            self.io_write(0x50, [int(arg0), int(arg1), 0, int(opcode)])
+            first = False
+
+        # Poll for the response of the last command
+        status = 0xFF
+
+        while (status == 0xFF):
+            rsp = self.io_read(0x54, 0x04)
+            status = rsp[0]
+
+        return (rsp[0], rsp[1], bytes(self.io_read(0x00, rsp_len)))
+
     def io_cmd_checked(self, opcode, arg0=0, arg1=0, arg2=0, data=[], rsp_len = 0):
         (status_0, status_1, data) = self.io_cmd(int(opcode), int(arg0), int(arg1), int(arg2), bytes(data), int(rsp_len))
 
@@ -112,7 +268,7 @@ class LPC810_CryptoMem:
         """
         Reads the current value of a PCR.
         """
-        return bytes(self.io_read(0x090 + int(idx) * 0x20, 0x20))
+        return bytes(self.cached_read(0x090 + int(idx) * 0x20, 0x20))
 
     def extend(self, idx, data):
         """
@@ -120,11 +276,28 @@ class LPC810_CryptoMem:
         """
         self.io_cmd_checked(opcode=0xE0, arg0=int(idx), arg1=len(data), data=bytes(data))
 
-    def quote(self, flags=0, data=[]):
+    def extend_vector(self, pcr_mask, data, digests=False):
         """
-        Quotes the current platform status.
+        Extends all PCRs selected by a bitmask with user-provided DATA (optionally as a list of
+        32-byte digests that are extended one after another).
         """
-        return self.io_cmd_checked(opcode=0xA0, arg0=int(flags), arg1=len(data), data=bytes(data), rsp_len=0x20)
+        arg0 = 0x10 | (int(pcr_mask) & 0x07) | (0x20 if digests else 0x00)
+        self.io_cmd_checked(opcode=0xE0, arg0=arg0, arg1=len(data), data=bytes(data))
+
+    def quote(self, flags=0, data=[], composite=False, nv_counters=False):
+        """
+        Quotes the current platform status (optionally including the composite PCR digest and the NV
+        monotonic counters).
+        """
+        arg1 = len(data) | (0x80 if composite else 0x00)
+        opcode = 0xA1 if nv_counters else 0xA0
+        return self.io_cmd_checked(opcode=opcode, arg0=int(flags), arg1=arg1, data=bytes(data), rsp_len=0x20)
+
+    def composite_pcr(self):
+        """
+        Reads the composite PCR digest (SHA-256 over all PCRs).
+        """
+        return self.io_cmd_checked(opcode=0xE1, rsp_len=0x20)
 
 
     def device_uid(self):
@@ -143,7 +316,7 @@ class LPC810_CryptoMem:
         """
         Reads the current value of the (lockable) volatile bits
         """
-        return struct.unpack("<I", self.io_read(0x058, 0x04))[0]
+        return struct.unpack("<I", self.cached_read(0x058, 0x04))[0]
 
     def volatile_locks(self):
         """
@@ -155,7 +328,7 @@ class LPC810_CryptoMem:
         """
         Reads the current value of the (lockable) volatile bits and locks
         """
-        return struct.unpack("<I", self.io_read(0x060 + 0x04 * int(idx), 0x04))[0]
+        return struct.unpack("<I", self.cached_read(0x060 + 0x04 * int(idx), 0x04))[0]
 
     def increment(self, idx, addend=1):
         """
@@ -163,12 +336,108 @@ class LPC810_CryptoMem:
         """
         return self.io_cmd(opcode=0xC0, arg0=int(idx), arg1=int(addend))
 
+    def hkdf_batch(self, seeds):
+        """
+        Derives one key per seed (up to two seeds of equal length) using the HMAC based KDF
+        """
+        seeds = [bytes(seed) for seed in seeds]
+        rsp = self.io_cmd_checked(opcode=0xB1, arg0=len(seeds[0]), arg1=len(seeds), data=b"".join(seeds), rsp_len=0x20 * len(seeds))
+        return [rsp[i:(i + 0x20)] for i in range(0, len(rsp), 0x20)]
+
+    def hkdf_counter(self, seed=[], length=0x20):
+        """
+        Derives key material from a seed using the HMAC based KDF in counter mode
+        """
+        return self.io_cmd_checked(opcode=0xB1, arg0=len(seed), arg1=(0x80 | int(length)), data=bytes(seed), rsp_len=int(length))
+
+    def nv_counters(self, increment_idx=None):
+        """
+        Reads the flash-backed monotonic counters (optionally after incrementing one of them by one;
+        requires a firmware build with CONFIG_CRYPTOMEM_NV_COUNTER)
+        """
+        if increment_idx is None:
+            rsp = self.io_cmd_checked(opcode=0xC1, arg0=0x00, arg1=0x00, rsp_len=0x08)
+        else:
+            rsp = self.io_cmd_checked(opcode=0xC1, arg0=int(increment_idx), arg1=0x01, rsp_len=0x08)
+
+        return struct.unpack("<II", rsp)
+
+    def count(self, idx, addend=1):
+        """
+        Increments a volatile counter via its increment-on-write alias register (no command
+        execution; requires a firmware build with CONFIG_CRYPTOMEM_COUNTER_ALIAS)
+        """
+        self.io_write(0x06D + int(idx), [int(addend)])
+
+    def counter_overflow(self, clear=False):
+        """
+        Reads (and optionally clears) the sticky overflow flags of the counter alias registers
+        """
+        flags = self.io_read(0x06F, 0x01)[0]
+        if clear and (flags != 0):
+            self.io_write(0x06F, [flags])
+
+        return flags
+
     def hkdf(self, seed=[]):
         """
         Derives a key using the HMAC based KDF
         """
         return self.io_cmd_checked(opcode=0xB0, arg0=len(seed), data=bytes(seed), rsp_len=0x20)
 
+    def measure(self, data, mode=1, arg=0):
+        """
+        Hashes DATA of arbitrary length in a streaming session (in 80-byte chunks) and completes the
+        session (mode 0: return digest, mode 1: extend into PCR #arg, mode 2: quote with bitmask arg).
+        Returns the session digest (or quote).
+        """
+        data = bytes(data)
+        self.io_cmd_checked(opcode=0xE4)
+
+        for offset in range(0, len(data), 0x50):
+            chunk = data[offset:(offset + 0x50)]
+            self.io_cmd_checked(opcode=0xE5, arg0=len(chunk), data=chunk)
+
+        rsp = self.io_cmd_checked(opcode=0xE6, arg0=int(mode), arg1=int(arg), rsp_len=0x24)
+        if (struct.unpack("<I", rsp[0x20:0x24])[0] != len(data)):
+            raise RuntimeError("hash session length mismatch")
+
+        return rsp[0x00:0x20]
+
+    def batch(self, entries, rsp_len=0):
+        """
+        Executes a list of (opcode, arg0, arg1, data) sub-commands in one batch command. Returns a
+        tuple of (return code, number of executed sub-commands, response data of the last one).
+        """
+        blob = b""
+        for (opcode, arg0, arg1, data) in entries:
+            blob += bytes([int(opcode), int(arg0), int(arg1), len(data)]) + bytes(data)
+
+        (status_0, status_1, data) = self.io_cmd(opcode=0xD0, arg0=len(blob), data=blob, rsp_len=int(rsp_len))
+        if (status_0 != 0xC3):
+            raise RuntimeError("remote i2c command failed (0x%02x 0x%02x)" % (status_0, status_1))
+
+        return (status_1, self.io_read(0x56, 0x01)[0], data)
+
+    def benchmark(self, mode=0, count=16, clock_hz=8000000):
+        """
+        Runs the on-device crypto self-test and benchmark (mode 0: SHA-256, mode 1: HMAC-SHA256)
+        and returns a tuple of (total cycles, cycles per SHA-256 compression, hashed bytes per second).
+        Pass clock_hz=24000000 for firmware builds with CONFIG_CRYPTOMEM_CLOCK_SCALING.
+        """
+        cycles = struct.unpack("<I", self.io_cmd_checked(opcode=0xF3, arg0=int(mode), arg1=int(count), rsp_len=0x04))[0]
+
+        blocks = int(count) * (1 if (int(mode) == 0) else 4)
+        return (cycles, cycles / blocks, (blocks * 64 * clock_hz) / cycles)
+
+    def telemetry(self, opcode, clear=False):
+        """
+        Reads the on-device telemetry record of a command and returns a tuple of (executions, failed executions,
+        last cycles, max cycles, ISR cycles during executions, total ISR cycles since startup).
+        """
+        rsp = self.io_cmd_checked(opcode=0xF4, arg0=int(opcode), arg1=(0x01 if clear else 0x00), rsp_len=0x18)
+        return struct.unpack("<6I", rsp)
+
 #---------------------------------------------------------------------------------------------------
 # Host side simulator
 #
@@ -204,6 +473,9 @@ class LPC810_CryptoMem_Simulator:
         self.volatile_ctr0 = 0
         self.volatile_ctr1 = 0
 
+        # Flash-backed monotonic counters
+        self.nv_ctr = [0, 0]
+
 
     def derive_device_key(self, ktype, kseed):
         hmac = HMAC.new(self.root_key, digestmod=SHA256)
@@ -211,23 +483,68 @@ class LPC810_CryptoMem_Simulator:
         hmac.update(bytes(ktype))
         return bytes(hmac.digest())
 
+    def device_key_states(self):
+        """
+        Computes the precomputed keyed HMAC states of the QUOT and HKDF device keys (as stored in NV pages
+        two and three by firmware builds with CONFIG_CRYPTOMEM_KEY_CACHE_NV).
+        """
+        return hmac_sha256_key_state(self.quote_key) + hmac_sha256_key_state(self.hkdf_key)
+
     def hkdf(self, seed=[]):
         hmac = HMAC.new(self.hkdf_key, digestmod=SHA256)
         hmac.update(bytes(seed))
         return bytes(hmac.digest())
 
+    def hkdf_counter(self, seed=[], length=0x20):
+        output = b""
+        for i in range(1, (int(length) + 31) // 32 + 1):
+            hmac = HMAC.new(self.hkdf_key, digestmod=SHA256)
+            hmac.update(struct.pack(">I", i))
+            hmac.update(bytes(seed))
+            output += bytes(hmac.digest())
+
+        return output[:int(length)]
+
     def extend(self, index, data):
         md = SHA256.new()
         md.update(bytes(self.pcrs[index]))
         md.update(bytes(data))
         self.pcrs[index] = bytes(md.digest())
 
+    def extend_vector(self, pcr_mask, data, digests=False):
+        data   = bytes(data)
+        chunks = [data[i:(i + 32)] for i in range(0, len(data), 32)] if digests else [data]
+
+        for index in range(3):
+            if (0 != (int(pcr_mask) & (1 << index))):
+                for chunk in chunks:
+                    self.extend(index, chunk)
+
+    def measure(self, data, mode=1, arg=0):
+        digest = bytes(SHA256.new(bytes(data)).digest())
+
+        if (int(mode) == 1):
+            self.extend(int(arg), digest)
+        elif (int(mode) == 2):
+            return self.quote(int(arg), digest)
+
+        return digest
+
     def pcr(self, index):
         return bytes(self.pcrs[index])
 
-    def quote(self, flags=0, data=[]):
+    def composite_pcr(self):
+        return bytes(SHA256.new(self.pcrs[0] + self.pcrs[1] + self.pcrs[2]).digest())
+
+    def nv_counters(self, increment_idx=None):
+        if increment_idx is not None:
+            self.nv_ctr[int(increment_idx)] += 1
+
+        return tuple(self.nv_ctr)
+
+    def quote(self, flags=0, data=[], composite=False, nv_counters=False):
         # Construct the header blob
-        pcr_mask = int(flags)
+        pcr_mask = int(flags) | (0x100 if composite else 0x000) | (0x200 if nv_counters else 0x000)
         data     = bytes(data)
 
         hmac = HMAC.new(self.quote_key, digestmod=SHA256)
@@ -251,10 +568,18 @@ class LPC810_CryptoMem_Simulator:
         if (0 != (pcr_mask & 0x10)):
             hmac.update(struct.pack("<I", self.volatile_ctr1))
 
+        # NV monotonic counters
+        if (0 != (pcr_mask & 0x200)):
+            hmac.update(struct.pack("<II", self.nv_ctr[0], self.nv_ctr[1]))
+
         # If enabled: User data
         if (0 != (pcr_mask & 0x08)):
             hmac.update(self.nv_user_data)
 
+        # If enabled: Composite PCR digest
+        if (0 != (pcr_mask & 0x100)):
+            hmac.update(self.composite_pcr())
+
         # And the enabled PCRs                
         if (0 != (pcr_mask & 0x04)):
             hmac.update(self.pcrs[2])
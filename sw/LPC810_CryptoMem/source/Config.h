@@ -17,4 +17,216 @@
 # define CONFIG_WIRED_IF_TYPE CONFIG_WIRED_IF_UART
 #endif
 
+// SHA-256 size-optimized profile (textbook round loop with circular word schedule)
+#define CONFIG_SHA256_PROFILE_SIZE  0x01
+
+// SHA-256 speed-optimized profile (unrolled rounds with inlined word schedule)
+#define CONFIG_SHA256_PROFILE_SPEED 0x02
+
+// Select the SHA-256 implementation profile (default to SIZE if not set)
+//
+// NOTE: The speed profile trades a significant amount of flash for a faster compression function. The
+// default I2C and UART builds already use most of the 4K flash of the LPC810, so other features may have to
+// be disabled when selecting the speed profile.
+#if !defined(CONFIG_SHA256_PROFILE)
+# define CONFIG_SHA256_PROFILE CONFIG_SHA256_PROFILE_SIZE
+#endif
+
+// No caching of the keyed HMAC states (device keys are derived from the root key on every use)
+#define CONFIG_CRYPTOMEM_KEY_CACHE_NONE 0x00
+
+// Cache the keyed HMAC states of the QUOT and HKDF device keys in RAM
+//
+// The cache holds the inner and outer SHA-256 chaining values of both device keys (128 bytes of SRAM). It is filled
+// on startup and refilled after the device configuration page has been rewritten.
+#define CONFIG_CRYPTOMEM_KEY_CACHE_RAM  0x01
+
+// Store precomputed keyed HMAC states of the QUOT and HKDF device keys in NV (flash)
+//
+// The states are kept in two extra NV pages (following the user data page). They are recomputed whenever the
+// device configuration page is rewritten, and are checked against it at startup (stale states left by a reset during
+// the rewrite are rewritten; the device keys are derived on every use until this succeeds). The check costs two
+// device key derivations at startup (and one byte of SRAM).
+#define CONFIG_CRYPTOMEM_KEY_CACHE_NV   0x02
+
+// Select the keyed HMAC state cache option (default to no caching if not set)
+//
+// With a key cache Quote and HMAC key derivation commands skip the device key derivation and the ipad/opad
+// compressions.
+#if !defined(CONFIG_CRYPTOMEM_KEY_CACHE)
+# define CONFIG_CRYPTOMEM_KEY_CACHE CONFIG_CRYPTOMEM_KEY_CACHE_NONE
+#endif
+
+// Use the specialized PCR extend path (default to disabled if not set)
+//
+// Extends with up to 23 bytes of data (one block) and with exactly 32 bytes of data (two blocks) skip the generic
+// buffer management. The constant second block of a 32-byte extend uses a precomputed message schedule (256 bytes
+// of flash).
+#if !defined(CONFIG_CRYPTOMEM_FAST_EXTEND)
+# define CONFIG_CRYPTOMEM_FAST_EXTEND 0
+#endif
+
+// Maintain a composite digest over the PCR bank (default to disabled if not set)
+//
+// The composite digest SHA-256(PCR_0 || PCR_1 || PCR_2) can be read with command 0xE1 and can be quoted instead of
+// the individual PCRs. It is recomputed on demand after the PCR bank has been extended (33 bytes of SRAM).
+#if !defined(CONFIG_CRYPTOMEM_COMPOSITE_PCR)
+# define CONFIG_CRYPTOMEM_COMPOSITE_PCR 0
+#endif
+
+// Enable the vector modes of the PCR extend command (default to disabled if not set)
+//
+// Vector extends apply the same data to several PCRs (PCR bitmask), and/or extend a sequence of 32-byte digests
+// one after another, within a single extend command.
+#if !defined(CONFIG_CRYPTOMEM_VECTOR_EXTEND)
+# define CONFIG_CRYPTOMEM_VECTOR_EXTEND 0
+#endif
+
+// Enable the streaming hash session commands (0xE4-0xE6; default to disabled if not set)
+//
+// A session keeps a dedicated SHA-256 context alive across commands (about 140 bytes of SRAM). This allows hosts to
+// measure objects larger than the DATA area in 80-byte chunks.
+#if !defined(CONFIG_CRYPTOMEM_SESSION)
+# define CONFIG_CRYPTOMEM_SESSION 0
+#endif
+
+// Maintain the device state generation register at 0x068 (default to disabled if not set)
+//
+// The register changes on every PCR extend, counter increment, volatile bit or lock update, and NV user data
+// reload. Hosts can poll it to detect changes of the register file.
+#if !defined(CONFIG_CRYPTOMEM_STATE_GENERATION)
+# define CONFIG_CRYPTOMEM_STATE_GENERATION 0
+#endif
+
+// Cache the quote prefix of the last quote (default to disabled if not set)
+//
+// The HMAC state after the quote header, device data and PCRs (the quote prefix) is cached together with the quote
+// bitmask and the device state generation. Repeated quotes with the same bitmask (and an unchanged device state)
+// only absorb the extra data (about 140 bytes of SRAM, plus a 132-byte working copy of the HMAC context on the stack
+// while a quote is completed).
+#if !defined(CONFIG_CRYPTOMEM_QUOTE_CACHE)
+# define CONFIG_CRYPTOMEM_QUOTE_CACHE 0
+#endif
+
+// The quote prefix cache relies on the device state generation
+#if (CONFIG_CRYPTOMEM_QUOTE_CACHE != 0) && (CONFIG_CRYPTOMEM_STATE_GENERATION == 0)
+# undef CONFIG_CRYPTOMEM_STATE_GENERATION
+# define CONFIG_CRYPTOMEM_STATE_GENERATION 1
+#endif
+
+// Enable the staging bank for the DATA and ARG registers (default to disabled if not set)
+//
+// While a command is executing, host writes to the DATA, ARG and CMD registers go to a staging bank (84 bytes of
+// SRAM). A staged CMD write starts the staged command automatically when the current command completes (if it
+// succeeded); otherwise the staged data is swapped in on the next host write (after the response has been read).
+#if !defined(CONFIG_CRYPTOMEM_STAGING)
+# define CONFIG_CRYPTOMEM_STAGING 0
+#endif
+
+// Enable the increment-on-write counter alias registers (default to disabled if not set)
+//
+// Bytes written to CTR_INC_0/CTR_INC_1 (0x06D/0x06E) are added to the volatile counters directly in the EEP write
+// callback (no command execution and no STAT polling needed).
+#if !defined(CONFIG_CRYPTOMEM_COUNTER_ALIAS)
+# define CONFIG_CRYPTOMEM_COUNTER_ALIAS 0
+#endif
+
+// Enable the batch HMAC key derivation command (0xB1; default to disabled if not set)
+//
+// The command derives two keys from two seeds, or up to 80 bytes of key material from one seed (counter mode), with
+// a single derivation of the HKDF device key (64 bytes of SRAM for its keyed HMAC state).
+#if !defined(CONFIG_CRYPTOMEM_BATCH_HKDF)
+# define CONFIG_CRYPTOMEM_BATCH_HKDF 0
+#endif
+
+// Enable the batch command (0xD0; default to disabled if not set)
+//
+// A batch executes a list of sub-commands from the DATA area back to back (with a single STAT poll by the host).
+#if !defined(CONFIG_CRYPTOMEM_BATCH)
+# define CONFIG_CRYPTOMEM_BATCH 0
+#endif
+
+// Count the SHA-256 compression function invocations (default to disabled if not set)
+//
+// The counter can be read with Sha256_GetCompressionCount. It allows benchmarks (e.g. of the command handlers in a
+// host build against a stub HAL) to check the number of compressions per operation.
+#if !defined(CONFIG_SHA256_STATS)
+# define CONFIG_SHA256_STATS 0
+#endif
+
+// Enable the crypto self-test and benchmark command (0xF3; default to disabled if not set)
+//
+// The command runs known-answer tests of SHA-256 and HMAC-SHA256 and reports the elapsed core clock cycles
+// (measured with the SysTick timer). Intended for development builds.
+#if !defined(CONFIG_CRYPTOMEM_BENCHMARK)
+# define CONFIG_CRYPTOMEM_BENCHMARK 0
+#endif
+
+// Enable per-command telemetry (0xF4; default to disabled if not set)
+//
+// The telemetry records the execution count, error count, and execution times (in core clock cycles; measured with
+// the SysTick timer) of each command, and the time spent in the wired interface ISR (about 210 bytes of SRAM).
+#if !defined(CONFIG_CRYPTOMEM_TELEMETRY)
+# define CONFIG_CRYPTOMEM_TELEMETRY 0
+#endif
+
+// Enable the alternate (polling-friendly) register map v2 (default to disabled if not set)
+//
+// If enabled, bit 7 of NV_SYS_CFG selects the register map v2 at startup. The v2 map rearranges the command window
+// (0x00-0x57) so that a command is issued with a single write (DATA, ARG_0-ARG_2 and CMD are contiguous), and its
+// completion status and response are returned by a single read (sequential reads of STAT, RET_0-RET_2 and the
+// response length wrap into DATA). All other registers are unchanged.
+#if !defined(CONFIG_CRYPTOMEM_REGISTER_MAP_V2)
+# define CONFIG_CRYPTOMEM_REGISTER_MAP_V2 0
+#endif
+
+// Number of slots per half of the wear-levelled NV user data log (0 = disabled; default to disabled if not set)
+//
+// If enabled, NV user data writes (0xF1/0x2A) append the new user data page to a log of 2 * N flash pages (one page
+// per slot) with a program-only write. Pages are only erased when the active half of the log is full and the log
+// moves on to the other half. Each record carries a SHA-256 check value; the newest valid record is located when the
+// device starts (records torn by a power loss are skipped). A value of N needs 2 * N * 64 bytes of flash; N must be
+// at least 2.
+#if !defined(CONFIG_CRYPTOMEM_NV_LOG_SLOTS)
+# define CONFIG_CRYPTOMEM_NV_LOG_SLOTS 0
+#endif
+
+// Enable the flash-backed monotonic counters (0xC1; default to disabled if not set)
+//
+// Each of the two NV counters uses a unary page and a rollover page (256 bytes of flash in total). An increment
+// clears one bit of the unary page with a program-only write. The unary page is only erased after 512 increments
+// (after a bit of the rollover page has been cleared). The counters can count up to 262656.
+#if !defined(CONFIG_CRYPTOMEM_NV_COUNTER)
+# define CONFIG_CRYPTOMEM_NV_COUNTER 0
+#endif
+
+// Keep the I2C interface responsive during flash erase and programming (default to disabled if not set)
+//
+// While an IAP flash operation runs, the vector table is relocated to SRAM and a minimal SRAM-resident I2C slave
+// handler serves the bus. Reads of the command window return busy (0xFF), other registers are read as usual, and
+// writes are not acknowledged. Without this option the I2C slave stalls until the flash operation is done. The
+// handler is placed in the RamFunction section, which the linker settings of the project map to SRAM; if the handler
+// is found outside of SRAM at runtime, the I2C slave stalls as without this option.
+//
+// SRAM cost: the 100-byte vector table, up to 124 bytes of padding for its 128-byte alignment (VTOR), and the
+// handler code with its literal pool (roughly 100 bytes; see the linker map), plus 9 bytes of variables.
+#if !defined(CONFIG_CRYPTOMEM_IAP_BUS_SERVICE)
+# define CONFIG_CRYPTOMEM_IAP_BUS_SERVICE 0
+#endif
+
+#if (CONFIG_CRYPTOMEM_IAP_BUS_SERVICE != 0) && (CONFIG_WIRED_IF_TYPE != CONFIG_WIRED_IF_I2C)
+# error "CONFIG_CRYPTOMEM_IAP_BUS_SERVICE requires the I2C wired interface"
+#endif
+
+// Run commands at the full PLL clock (default to disabled if not set)
+//
+// The core runs at 24 MHz (PLL output; two system clocks flash access time) while a command executes, and drops back
+// to the 8 MHz default clock (one system clock flash access time) before the completion status is published. A staged
+// command that starts right away keeps the fast clock. The I2C slave clock divider is re-derived on every switch; the
+// UART clock is derived from the main clock and is not affected. Clock scaling stops after a switch to the external
+// clock (0xF2).
+#if !defined(CONFIG_CRYPTOMEM_CLOCK_SCALING)
+# define CONFIG_CRYPTOMEM_CLOCK_SCALING 0
+#endif
+
 #endif /* CONFIG_H_ */
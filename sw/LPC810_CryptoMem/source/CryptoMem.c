@@ -37,7 +37,7 @@
 // ------+------------+------------+------------+------------+------------+------------+------------+------------+
 // 0x060 | VOLATILE_COUNTER_1[31:0]                          | VOLATILE_COUNTER_0[31:0]                          |
 // ------+------------+------------+------------+------------+------------+------------+------------+------------+
-// 0x068 | RFU (WI/RAZ)                                                                                          |
+// 0x068 |  CTR_OVF   | CTR_INC_1  | CTR_INC_0  | STAGE_STAT | STATE_GENERATION[31:0] (RO)                       |
 // ------+------------+------------+------------+------------+------------+------------+------------+------------+
 // 0x070 | USER_DATA[255:0]                                                                                      |
 // 0x078 |                                                                                                       |
@@ -88,11 +88,71 @@
 //
 //     The argument register is automatically cleared when the command starts executing.
 //
-// RET_1: Return code of the previous command (zero indicates successful execution)
+// RET_1: Command defined return value (see command description). All commands except the batch execution command
+//     (0xD0) set RET_1 to zero. The batch execution command returns the number of executed sub-commands (including
+//     a failed sub-command) in RET_1. The return code of a command is reported in RET_0.
 //
 // RET_2: User defined return register (mirror of ARG_2); this register mirrors the value that is received
 //     form ARG_2 of the associated command (after completion of the command).
 //
+// STATE_GENERATION: Device state generation (CONFIG_CRYPTOMEM_STATE_GENERATION builds only; reads as zero otherwise).
+//     The register changes whenever a PCR is extended, a volatile counter is incremented, the volatile bits or locks
+//     are written, the NV user data is reloaded, or an NV counter is incremented. Hosts can skip re-reading the
+//     register file while the generation is unchanged. Write attempts are ignored.
+//
+// STAGE_STAT: Staging bank status (CONFIG_CRYPTOMEM_STAGING builds only; reads as zero otherwise).
+//     [7:2] Reserved (zero)
+//     [1]   A command has been staged (CMD was written while the current command is executing); the staging bank is
+//           sealed until the staged command has been swapped in
+//     [0]   The staging bank holds data
+//
+//     While a command is executing, writes to DATA, ARG_0-ARG_2 and CMD go to the staging bank. If a command has
+//     been staged and the completed command succeeded, the staging bank replaces the DATA and ARG registers (the
+//     response data of the completed command is lost) and the staged command starts immediately. Otherwise STAT
+//     reports the completed command with its response data, and the staged data (bit [0]) stays pending: it
+//     replaces the DATA and ARG registers on the next host write to DATA, ARG_0-ARG_2 or CMD (so writing CMD
+//     executes a command with the staged data). Write attempts to STAGE_STAT are ignored.
+//
+// CTR_INC_0, CTR_INC_1: Increment-on-write aliases of the volatile counters (CONFIG_CRYPTOMEM_COUNTER_ALIAS builds
+//     only; write ignored otherwise). A byte written to CTR_INC_n is added to VOLATILE_COUNTER_n (with the overflow
+//     rule of the increment counter command: an increment that would overflow the counter is discarded). These
+//     registers are also writable while a command is executing, and read as zero.
+//
+// CTR_OVF: Sticky counter overflow flags (CONFIG_CRYPTOMEM_COUNTER_ALIAS builds only; reads as zero otherwise).
+//     [7:2] Reserved (zero)
+//     [1]   An increment of VOLATILE_COUNTER_1 via CTR_INC_1 was discarded (counter overflow)
+//     [0]   An increment of VOLATILE_COUNTER_0 via CTR_INC_0 was discarded (counter overflow)
+//
+//     Writing a one to a flag clears it.
+//
+
+//---------------------------------------------------------------------------------------------------------------------
+//
+// Register map v2 (command window; CONFIG_CRYPTOMEM_REGISTER_MAP_V2 builds with NV_SYS_CFG[7] set)
+//
+//       |         +7 |         +6 |         +5 |         +4 |         +3 |         +2 |         +1 |         +0 |
+// ======+============+============+============+============+============+============+============+============+
+// 0x000 |   DATA[639:0]                                                                                         |
+//  ...  |                                                                                                       |
+// 0x048 |                                                                                                       |
+// ------+------------+------------+------------+------------+------------+------------+------------+------------+
+// 0x050 |  RSP_LEN   |    RET_2   |    RET_1   |   RET_0    | CMD / STAT |   ARG_2    |   ARG_1    |   ARG_0    |
+// ------+------------+------------+------------+------------+------------+------------+------------+------------+
+// 0x058 | (unchanged; see above)                                                                                |
+// ------+------------+------------+------------+------------+------------+------------+------------+------------+
+//
+// CMD / STAT: Writes go to the CMD register, reads return the STAT register.
+//
+// RSP_LEN: Length of the response data of the previous command (in bytes). Write attempts are ignored.
+//
+// DATA, ARG_0-ARG_2 and CMD are contiguous: a host issues a command with a single write at 0x00 that covers the
+// input data, the arguments and the command code (or a single write at 0x50 for commands without input data).
+//
+// Sequential reads wrap from RSP_LEN (0x57) to the start of DATA (0x00). A host polls for completion with a single
+// read at 0x53 that covers STAT, RET_0-RET_2, RSP_LEN, and the expected response data. The complete command window
+// reads as IOMEM_STAT_BUSY (0xFF) while a command is ongoing. The registers from 0x58 onwards are not reachable by
+// a sequential read that crosses 0x57 (they need a separate read).
+//
 
 // Command: 0x00 - No Operation / Clear Data
 //  The NOP command clears the DATA register
@@ -120,7 +180,13 @@ typedef union {
 
 		uint32_t VOLATILE_COUNTER[2u];
 
-		uint8_t RFU[8u];
+		volatile uint32_t STATE_GENERATION;
+
+		volatile uint8_t STAGE_STAT;
+
+		uint8_t CTR_INC[2u];
+
+		volatile uint8_t CTR_OVF;
 
 		uint8_t USER_DATA[32u];
 
@@ -157,14 +223,68 @@ _Static_assert(sizeof(gIoMem.regs) == 256u, "Size of  I/O register structure (bi
 #define IOMEM_STAT_BUSY  UINT8_C(0xFFu)
 #define IOMEM_STAT_READY UINT8_C(0xC3u)
 
+#define IOMEM_STAGE_STAT_DATA  UINT8_C(0x01u)
+#define IOMEM_STAGE_STAT_START UINT8_C(0x02u)
+
 /**
  * @brief Gets the byte-offset of a named register in the I/O memory block
  */
 #define IOMEM_REG_OFF(name) (__builtin_offsetof(CryptoMem_IoMem_t, regs.name))
 
+#if (CONFIG_CRYPTOMEM_REGISTER_MAP_V2 != 0)
+#define IOMEM_V2_OFF_CMD_STAT UINT8_C(0x53u)
+#define IOMEM_V2_OFF_RET      UINT8_C(0x54u)
+#define IOMEM_V2_OFF_RSP_LEN  UINT8_C(0x57u)
+
+_Static_assert(IOMEM_V2_OFF_CMD_STAT == IOMEM_REG_OFF(CMD),
+	"DATA and ARG_0-ARG_2 of the register map v2 must match the default register map.");
+
+_Static_assert(IOMEM_V2_OFF_RSP_LEN + 1u == IOMEM_REG_OFF(VOLATILE_BITS),
+	"Command window of the register map v2 must match the command window of the default register map.");
+
+/**
+ * @brief Register map v2 is selected (latched from NV_SYS_CFG at startup)
+ */
+static bool gRegMapV2;
+
+/**
+ * @brief Response data length of the previous command (RSP_LEN register of the register map v2)
+ */
+static uint8_t gRegMapV2RspLength;
+#endif
+
+#if (CONFIG_CRYPTOMEM_STAGING != 0)
+/**
+ * @brief Staging bank for the DATA, ARG_0-ARG_2 and CMD registers (same layout as the I/O memory)
+ */
+static uint8_t gStaging[IOMEM_REG_OFF(STAT)];
+#endif
+
 
 //---------------------------------------------------------------------------------------------------------------------
 
+//---------------------------------------------------------------------------------------------------------------------
+/**
+ * @brief Device-specific keys (derived from the root key)
+ */
+typedef enum
+{
+	/**
+	 * @brief Quote signing key (derived from QUOTE_KEY_SEED)
+	 */
+	kCryptoMem_DeviceKeyQuote,
+
+	/**
+	 * @brief HMAC key derivation key (derived from HKDF_KEY_SEED)
+	 */
+	kCryptoMem_DeviceKeyHmacKdf,
+
+	/**
+	 * @brief Number of device-specific keys
+	 */
+	kCryptoMem_NumDeviceKeys
+} CryptoMem_DeviceKey_t;
+
 //---------------------------------------------------------------------------------------------------------------------
 //
 //       |         +7 |         +6 |         +5 |         +4 |         +3 |         +2 |         +1 |         +0 |
@@ -192,6 +312,30 @@ _Static_assert(sizeof(gIoMem.regs) == 256u, "Size of  I/O register structure (bi
 // 0x070 |                                                                                                       |
 // 0x078 |                                                                                                       |
 // ======+============+============+============+============+============+============+============+============+
+// 0x080 | QUOTE_KEY_STATE[511:0] (CONFIG_CRYPTOMEM_KEY_CACHE_NV only)                                           |
+//  ...  |                                                                                                       |
+// 0x0B8 |                                                                                                       |
+// ======+============+============+============+============+============+============+============+============+
+// 0x0C0 | HKDF_KEY_STATE[511:0] (CONFIG_CRYPTOMEM_KEY_CACHE_NV only)                                            |
+//  ...  |                                                                                                       |
+// 0x0F8 |                                                                                                       |
+// ======+============+============+============+============+============+============+============+============+
+
+/**
+ * @brief NV user data page
+ */
+typedef struct
+{
+	/**
+	 * @brief NV user data stored on the device.
+	 */
+	uint8_t NV_USER_DATA[32u];
+
+	/**
+	 * @brief SHA-256 hash of the write password for the NV user data.
+	 */
+	uint8_t NV_USER_AUTH[32u];
+} CryptoMem_NvUserPage_t;
 
 /**
  * NV memory
@@ -209,7 +353,7 @@ typedef struct {
 		/**
 		 *  @brief System Configuration
 		 */
-		union
+		volatile union
 		{
 			/**
 			 * @brief Bit-field view.
@@ -221,10 +365,15 @@ typedef struct {
 				 */
 				uint32_t I2C_ADDR : 7;
 
+				/**
+				 * @brief Register map selection (0 = default map; 1 = register map v2)
+				 */
+				uint32_t REG_MAP_V2 : 1;
+
 				/**
 				 * @brief Reserved for future use
 				 */
-				uint32_t RFU : 25;
+				uint32_t RFU : 24;
 			} bits;
 
 			/**
@@ -244,14 +393,14 @@ typedef struct {
 		uint32_t NV_VOLATILE_LOCKS_INIT;
 
 		/**
-		 * @brief Seed for storage key derivation (from the root key)
+		 * @brief Seed for storage key derivation (from the root key; volatile as it is rewritten at runtime)
 		 */
-		uint8_t HKDF_KEY_SEED[8u];
+		volatile uint8_t HKDF_KEY_SEED[8u];
 
 		/**
-		 * @brief Seed for quote key derivation (from the quote key)
+		 * @brief Seed for quote key derivation (from the quote key; volatile as it is rewritten at runtime)
 		 */
-		uint8_t QUOTE_KEY_SEED[8u];
+		volatile uint8_t QUOTE_KEY_SEED[8u];
 
 		/**
 		 * @brief Device Root Key
@@ -260,20 +409,16 @@ typedef struct {
 	} page0;
 
 	/**
-	 * @brief Page one
+	 * @brief Page one (initial NV user data page; superseded by the newest NV log record if the NV log is enabled)
 	 */
-	struct
-	{
-		/**
-		 * @brief NV user data stored on the device.
-		 */
-		uint8_t NV_USER_DATA[32u];
+	CryptoMem_NvUserPage_t page1;
 
-		/**
-		 * @brief SHA-256 hash of the write password for the NV user data.
-		 */
-		uint8_t NV_USER_AUTH[32u];
-	} page1;
+#if (CONFIG_CRYPTOMEM_KEY_CACHE == CONFIG_CRYPTOMEM_KEY_CACHE_NV)
+	/**
+	 * @brief Pages two and three (precomputed keyed HMAC states of the device keys; indexed by device key)
+	 */
+	Sha256_HmacState_t KEY_STATE[kCryptoMem_NumDeviceKeys];
+#endif
 } CryptoMem_Nv_t;
 
 HAL_NV_DATA const CryptoMem_Nv_t gNv =
@@ -288,8 +433,9 @@ HAL_NV_DATA const CryptoMem_Nv_t gNv =
 			{
 					.bits =
 					{
-						.I2C_ADDR = 0x20,
-						.RFU      = 0u
+						.I2C_ADDR   = 0x20,
+						.REG_MAP_V2 = 0u,
+						.RFU        = 0u
 					}
 			},
 
@@ -326,157 +472,1003 @@ HAL_NV_DATA const CryptoMem_Nv_t gNv =
 					0x08u, 0x97u, 0x14u, 0x85u, 0x6eu, 0xe2u, 0x33u, 0xb3u, 0x90u, 0x2au, 0x59u, 0x1du, 0x0du, 0x5fu, 0x29u, 0x25u
 
 			}
+	},
+
+#if (CONFIG_CRYPTOMEM_KEY_CACHE == CONFIG_CRYPTOMEM_KEY_CACHE_NV)
+	// Default: Keyed HMAC states for the default root key and seeds (see device_key_states() in cryptomem.py)
+	.KEY_STATE =
+	{
+			[kCryptoMem_DeviceKeyQuote] =
+			{
+					.inner =
+					{
+							UINT32_C(0x21415a31), UINT32_C(0x8eab8608), UINT32_C(0xc8c7978b), UINT32_C(0x4bbbcd4e),
+							UINT32_C(0x50a62424), UINT32_C(0xa3a83697), UINT32_C(0x8a21e15e), UINT32_C(0xdeb35925)
+					},
+
+					.outer =
+					{
+							UINT32_C(0x7b546729), UINT32_C(0xf67bd683), UINT32_C(0xa50cfe81), UINT32_C(0xc9418649),
+							UINT32_C(0xec564584), UINT32_C(0x536d362e), UINT32_C(0x13ab1ed8), UINT32_C(0x07418330)
+					}
+			},
+
+			[kCryptoMem_DeviceKeyHmacKdf] =
+			{
+					.inner =
+					{
+							UINT32_C(0xd9f41a03), UINT32_C(0x703baeea), UINT32_C(0xc83857ef), UINT32_C(0x04556452),
+							UINT32_C(0xd30f6392), UINT32_C(0x94fe9f66), UINT32_C(0x08365cac), UINT32_C(0xd4945923)
+					},
+
+					.outer =
+					{
+							UINT32_C(0xff6a26b0), UINT32_C(0xfd356ed8), UINT32_C(0x985b16b1), UINT32_C(0x38f114fb),
+							UINT32_C(0x93fd227a), UINT32_C(0x3705ed1a), UINT32_C(0xd34bcb19), UINT32_C(0x9bfe2cd9)
+					}
+			}
 	}
+#endif
 };
 
 _Static_assert(sizeof(gNv.page0) == 64u, "Size of NV page 0 structure (raw view) must be exactly 128 bytes.");
 _Static_assert(sizeof(gNv.page1) == 64u, "Size of NV page 1 structure (raw view) must be exactly 128 bytes.");
+#if (CONFIG_CRYPTOMEM_KEY_CACHE == CONFIG_CRYPTOMEM_KEY_CACHE_NV)
+_Static_assert(sizeof(gNv.KEY_STATE[0u]) == HAL_NV_PAGE_SIZE, "Size of a keyed HMAC state must be exactly one NV page.");
+_Static_assert(sizeof(gNv) == 256u, "Size of NV structure (raw view) must be exactly 256 bytes.");
+#else
 _Static_assert(sizeof(gNv) == 128u, "Size of NV structure (raw view) must be exactly 128 bytes.");
+#endif
 
-//---------------------------------------------------------------------------------------------------------------------
-static const uint8_t kTag_Quote[4u]    = "QUOT";
-static const uint8_t kTag_HmacKdf[4u]  = "HKDF";
+#if (CONFIG_CRYPTOMEM_NV_LOG_SLOTS != 0)
+_Static_assert(CONFIG_CRYPTOMEM_NV_LOG_SLOTS >= 2, "The NV log needs at least two slots per half.");
 
-//---------------------------------------------------------------------------------------------------------------------
-static bool CryptoMem_IsDeviceUnlocked(void)
+/**
+ * @brief Record of the NV user data log
+ */
+typedef struct
 {
-	return (gNv.page0.NV_UNLOCK_MARKER == UINT32_C(0xAACCEE55));
-}
+	/**
+	 * @brief NV user data stored on the device.
+	 */
+	uint8_t NV_USER_DATA[32u];
+
+	/**
+	 * @brief Check value of the record: SHA-256(NV_USER_DATA || NV_USER_AUTH)
+	 *
+	 * Records with a wrong check value (torn by a power loss while programming or erasing) are skipped.
+	 */
+	uint8_t NV_CHECK[32u];
+} CryptoMem_NvLogRecord_t;
+
+_Static_assert(sizeof(CryptoMem_NvLogRecord_t) == HAL_NV_PAGE_SIZE, "A NV log record must occupy exactly one NV page.");
+
+/**
+ * @brief Wear-levelled NV user data log (two halves of CONFIG_CRYPTOMEM_NV_LOG_SLOTS pages; initially erased)
+ *
+ * Records are appended to the active half in slot order. When the active half is full, the next record goes to the
+ * first slot of the other half, and the full half is erased afterwards (from the first to the last slot). If this
+ * erase is interrupted, the stale half still has its last slot programmed and is recognized at startup.
+ */
+HAL_NV_DATA const CryptoMem_NvLogRecord_t gNvLog[2u][CONFIG_CRYPTOMEM_NV_LOG_SLOTS] =
+{
+	[0u ... 1u] =
+	{
+		[0u ... (CONFIG_CRYPTOMEM_NV_LOG_SLOTS - 1u)] =
+		{
+			.NV_USER_DATA = { [0u ... 31u] = 0xFFu },
+			.NV_CHECK     = { [0u ... 31u] = 0xFFu }
+		}
+	}
+};
+
+/**
+ * @brief Active half of the NV log
+ */
+static uint32_t gNvLogHalf;
+
+/**
+ * @brief Next free slot in the active half of the NV log
+ */
+static uint32_t gNvLogNext;
 
+/**
+ * @brief Current NV user data (initial page in gNv, or the newest valid NV log record)
+ */
+static const uint8_t *gNvUserData;
+
+# define CRYPTOMEM_NV_USER_DATA (gNvUserData)
+#else
+# define CRYPTOMEM_NV_USER_DATA (&gNv.page1.NV_USER_DATA[0u])
+#endif
+
+#if (CONFIG_CRYPTOMEM_NV_COUNTER != 0)
+/**
+ * @brief Pages of a flash-backed monotonic counter (initially erased)
+ *
+ * The counter value is 512 times the number of cleared bits in the rollover page plus the number of cleared bits in
+ * the unary page. Each increment clears the lowest bit that is still set (program-only write); an interrupted erase
+ * can leave set bits below cleared ones, and these are used up first (the counter never stalls or goes backwards).
+ */
+typedef struct
+{
+	/**
+	 * @brief Unary page (one cleared bit per increment; volatile as the flash changes under the compiler's view)
+	 */
+	volatile uint32_t UNITS[HAL_NV_PAGE_SIZE / sizeof(uint32_t)];
+
+	/**
+	 * @brief Rollover page (one cleared bit per erase of the unary page)
+	 */
+	volatile uint32_t ROLLOVERS[HAL_NV_PAGE_SIZE / sizeof(uint32_t)];
+} CryptoMem_NvCounterPages_t;
+
+/**
+ * @brief Number of bits in a page of a flash-backed monotonic counter
+ */
+#define CRYPTOMEM_NV_COUNTER_PAGE_BITS (HAL_NV_PAGE_SIZE * 8u)
+
+/**
+ * @brief Flash-backed monotonic counters
+ */
+HAL_NV_DATA const CryptoMem_NvCounterPages_t gNvCounterPages[2u] =
+{
+	[0u ... 1u] =
+	{
+		.UNITS     = { [0u ... 15u] = UINT32_C(0xFFFFFFFF) },
+		.ROLLOVERS = { [0u ... 15u] = UINT32_C(0xFFFFFFFF) }
+	}
+};
+
+_Static_assert(sizeof(gNvCounterPages[0u]) == 2u * HAL_NV_PAGE_SIZE, "A NV counter must occupy exactly two NV pages.");
+
+/**
+ * @brief RAM mirror of the flash-backed monotonic counters
+ */
+static uint32_t gNvCounter[2u];
+#endif
 
+#if (CONFIG_CRYPTOMEM_NV_LOG_SLOTS != 0)
 //---------------------------------------------------------------------------------------------------------------------
-static void CryptoMem_DeriveDeviceKey(uint8_t key[SHA256_HASH_LENGTH_BYTES], const uint8_t seed[8u], const uint8_t type[4u])
+static bool CryptoMem_NvLogIsBlank(const CryptoMem_NvLogRecord_t *const record)
 {
-	// First derive the device-specific key
-	//  key = HMAC_{ROOT_KEY} ( seed || type )
+	// Erased flash reads as all-ones
+	const uint32_t *const words = (const uint32_t *) record;
+	uint32_t acc = UINT32_MAX;
 
-	// Construct the input block:
-	__UNALIGNED_UINT32_WRITE(&key[ 0u], __UNALIGNED_UINT32_READ(&seed[0u]));
-	__UNALIGNED_UINT32_WRITE(&key[ 4u], __UNALIGNED_UINT32_READ(&seed[4u]));
-	__UNALIGNED_UINT32_WRITE(&key[ 8u], __UNALIGNED_UINT32_READ(&type[0u]));
+	for (uint32_t i = 0u; i < sizeof(*record) / sizeof(uint32_t); ++i)
+	{
+		acc &= words[i];
+	}
 
-	// Derive the key (via HMAC)
-	Sha256_HmacInit(gNv.page0.ROOT_KEY, sizeof(gNv.page0.ROOT_KEY));
-	Sha256_HmacUpdate(key, 8u + 4u);
-	Sha256_HmacFinal(key);
+	return (acc == UINT32_MAX);
 }
 
 //---------------------------------------------------------------------------------------------------------------------
-static void CryptoMem_HmacInitFromDeviceKey(const uint8_t seed[8u], const uint8_t type[4u])
+static void CryptoMem_NvLogComputeCheck(const uint8_t user_data[32u], uint8_t check[SHA256_HASH_LENGTH_BYTES])
 {
-	uint8_t key[SHA256_HASH_LENGTH_BYTES];
-
-	// Derive the device specific key
-	CryptoMem_DeriveDeviceKey(key, seed, type);
+	// The write password hash (NV_USER_AUTH) never changes; it binds the check value to this device
+	Sha256_Init();
+	Sha256_Update(&user_data[0u], 32u);
+	Sha256_Update(&gNv.page1.NV_USER_AUTH[0u], sizeof(gNv.page1.NV_USER_AUTH));
+	Sha256_Final(&check[0u]);
+}
 
-	// Next initialize the HMAC
-	Sha256_HmacInit(key, SHA256_HASH_LENGTH_BYTES);
+//---------------------------------------------------------------------------------------------------------------------
+static bool CryptoMem_NvLogIsValid(const CryptoMem_NvLogRecord_t *const record)
+{
+	uint8_t check[SHA256_HASH_LENGTH_BYTES];
 
-	// And clear the derived key
-	__builtin_memset(key, 0u, sizeof(key));
+	CryptoMem_NvLogComputeCheck(&record->NV_USER_DATA[0u], check);
+	return 0u == __builtin_memcmp(&check[0u], &record->NV_CHECK[0u], sizeof(check));
 }
 
 //---------------------------------------------------------------------------------------------------------------------
-uint8_t Eep_ByteReadCallback(uint8_t address)
+static bool CryptoMem_NvLogEraseHalf(const uint32_t half)
 {
-	if (address <= IOMEM_REG_OFF(STAT))
+	// Erase from the first to the last slot (pages that are already blank are skipped)
+	for (uint32_t i = 0u; i < CONFIG_CRYPTOMEM_NV_LOG_SLOTS; ++i)
 	{
-		// Addresses less or equal to the state register read as IOMEM_STAT_BUSY (0xFF) while a command is ongoing
-		if (gCommandActive)
+		if (!CryptoMem_NvLogIsBlank(&gNvLog[half][i]) && !Hal_NvErase(&gNvLog[half][i]))
 		{
-			return UINT8_C(0xFF);
+			return false;
 		}
 	}
 
-	return gIoMem.raw[address];
+	return true;
 }
 
 //---------------------------------------------------------------------------------------------------------------------
-void Eep_ByteWriteCallback(uint8_t address, uint8_t data)
+static void CryptoMem_NvLogInit(void)
 {
-	// Write access is only allowed when no command is active
-	//
-	// Any writes to the CMD register trigger activation of a command
-	switch (address)
-	{
-	case IOMEM_REG_OFF(CMD):
-		if (!gCommandActive)
-		{
-			// Update the status and RET registers (this ensures that we __always__ read consistent values
-			// even if the next I2C read interrupt comes before we dispatch)
-			gIoMem.regs.CMD = data;
-			gIoMem.regs.STAT = IOMEM_STAT_BUSY;
-			gIoMem.regs.RET_0 = 0u;
-			gIoMem.regs.RET_1 = 0u;
-			gIoMem.regs.RET_2 = 0u;
-
-			// Write to the CMD register (activate a new command) and update
-			gCommandActive = true;
+	uint32_t fill[2u];
+	const CryptoMem_NvLogRecord_t *newest[2u];
 
-			// Issue memory barrier (also for compiler) and set the event flag
-			__DMB();
-			__SEV();
-		}
-		break;
+	for (uint32_t half = 0u; half < 2u; ++half)
+	{
+		// Find the number of used slots (up to and including the last programmed slot)
+		fill[half] = 0u;
 
-	case IOMEM_REG_OFF(VOLATILE_LOCKS) + 0u:
-	case IOMEM_REG_OFF(VOLATILE_LOCKS) + 1u:
-	case IOMEM_REG_OFF(VOLATILE_LOCKS) + 2u:
-	case IOMEM_REG_OFF(VOLATILE_LOCKS) + 3u:
-		// Update volatile lock bits (allow toggle from 0->1)
+		for (uint32_t i = 0u; i < CONFIG_CRYPTOMEM_NV_LOG_SLOTS; ++i)
 		{
-			const uint8_t old_lock = gIoMem.raw[address];
-			gIoMem.raw[address] = (uint8_t) (old_lock | data);
+			if (!CryptoMem_NvLogIsBlank(&gNvLog[half][i]))
+			{
+				fill[half] = i + 1u;
+			}
 		}
-		break;
-
-	case IOMEM_REG_OFF(VOLATILE_BITS) + 0u:
-	case IOMEM_REG_OFF(VOLATILE_BITS) + 1u:
-	case IOMEM_REG_OFF(VOLATILE_BITS) + 2u:
-	case IOMEM_REG_OFF(VOLATILE_BITS) + 3u:
-		// Update volatile value bits (allow value changes only where lock bit is 0)
-		//
-		{
-			const uint8_t lock_mask = gIoMem.raw[address - IOMEM_REG_OFF(VOLATILE_BITS) + IOMEM_REG_OFF(VOLATILE_LOCKS)];
-			const uint8_t old_value = gIoMem.raw[address];
 
-			gIoMem.raw[address] = (uint8_t) ((old_value & lock_mask) | (data & ~lock_mask));
-		}
-		break;
+		// Find the newest valid record (torn records are skipped in favour of the previous valid record)
+		newest[half] = NULL;
 
-	default:
-		// Allow the write if the address is below the "STAT" field
-		if (address < IOMEM_REG_OFF(STAT))
+		for (uint32_t i = fill[half]; i > 0u; --i)
 		{
-			if (!gCommandActive)
+			if (CryptoMem_NvLogIsValid(&gNvLog[half][i - 1u]))
 			{
-				// Update the raw view of the I/O memory space
-				gIoMem.raw[address] = data;
+				newest[half] = &gNvLog[half][i - 1u];
+				break;
 			}
 		}
-		break;
 	}
-}
 
+	if ((fill[0u] != 0u) && (fill[1u] != 0u))
+	{
+		// An interrupted move to the other half left both halves in use. The move is complete if the new half holds
+		// a valid record (finish the erase of the full half); otherwise the first record of the new half is torn and
+		// the new half is discarded.
+		const uint32_t full = (fill[0u] == CONFIG_CRYPTOMEM_NV_LOG_SLOTS) ? 0u : 1u;
+		const uint32_t stale = (newest[full ^ 1u] != NULL) ? full : (full ^ 1u);
+
+		(void) CryptoMem_NvLogEraseHalf(stale);
+		fill[stale] = 0u;
+		newest[stale] = NULL;
+	}
+
+	gNvLogHalf = (fill[1u] != 0u) ? 1u : 0u;
+	gNvLogNext = fill[gNvLogHalf];
+
+	// Use the initial user data page until the first valid record has been written
+	gNvUserData = (newest[gNvLogHalf] != NULL) ? &newest[gNvLogHalf]->NV_USER_DATA[0u] : &gNv.page1.NV_USER_DATA[0u];
+}
 
 //---------------------------------------------------------------------------------------------------------------------
-void CryptoMem_Init(void)
+static bool CryptoMem_NvLogAppend(uint8_t nv_page[HAL_NV_PAGE_SIZE])
 {
-	// I setup of the I/O memory structure
-	__builtin_memset(&gIoMem, 0u, sizeof(gIoMem));
+	// Seal the record (the check value replaces the password hash in the second half of the page)
+	CryptoMem_NvLogComputeCheck(&nv_page[0u], &nv_page[32u]);
 
-	// Latch the device ID
-	Hal_ReadDeviceID(&gIoMem.regs.DEVICE_UID[0u]);
+	if (gNvLogNext < CONFIG_CRYPTOMEM_NV_LOG_SLOTS)
+	{
+		// Common case: program-only write to the next free slot of the active half
+		const CryptoMem_NvLogRecord_t *const slot = &gNvLog[gNvLogHalf][gNvLogNext];
 
-	gIoMem.regs.STAT = IOMEM_STAT_READY; // We are ready for operation
-	gCommandActive = false; // No commands are active
+		// The slot is used up even if programming fails (a torn record is never programmed twice)
+		gNvLogNext++;
 
-	// Initialize the lockable bits from NV
-	gIoMem.regs.VOLATILE_BITS  = gNv.page0.NV_VOLATILE_BITS_INIT;
+		if (!Hal_NvProgram(slot, nv_page))
+		{
+			return false;
+		}
+
+		gNvUserData = &slot->NV_USER_DATA[0u];
+		return true;
+	}
+	else
+	{
+		// The active half is full: continue with the first slot of the other half, then erase the full half
+		//
+		// The other half only becomes active once its first record is programmed (a torn first record is erased
+		// and programmed again by the next append).
+		const uint32_t full_half = gNvLogHalf;
+		const CryptoMem_NvLogRecord_t *const slot = &gNvLog[full_half ^ 1u][0u];
+
+		if (!CryptoMem_NvLogEraseHalf(full_half ^ 1u) || !Hal_NvProgram(slot, nv_page))
+		{
+			return false;
+		}
+
+		gNvLogHalf = full_half ^ 1u;
+		gNvLogNext = 1u;
+		gNvUserData = &slot->NV_USER_DATA[0u];
+
+		return CryptoMem_NvLogEraseHalf(full_half);
+	}
+}
+#endif
+
+#if (CONFIG_CRYPTOMEM_NV_COUNTER != 0)
+//---------------------------------------------------------------------------------------------------------------------
+static uint32_t CryptoMem_NvCounterCountBits(const volatile uint32_t page[HAL_NV_PAGE_SIZE / sizeof(uint32_t)])
+{
+	// Count the cleared bits of a counter page
+	uint32_t count = 0u;
+
+	for (uint32_t i = 0u; i < HAL_NV_PAGE_SIZE / sizeof(uint32_t); ++i)
+	{
+		count += (uint32_t) __builtin_popcount(~page[i]);
+	}
+
+	return count;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+static uint32_t CryptoMem_NvCounterRead(const uint32_t index)
+{
+	const CryptoMem_NvCounterPages_t *const pages = &gNvCounterPages[index];
+
+	return CryptoMem_NvCounterCountBits(pages->ROLLOVERS) * CRYPTOMEM_NV_COUNTER_PAGE_BITS +
+		CryptoMem_NvCounterCountBits(pages->UNITS);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+static bool CryptoMem_NvCounterClearBit(const volatile uint32_t page[HAL_NV_PAGE_SIZE / sizeof(uint32_t)],
+	uint32_t scratch[HAL_NV_PAGE_SIZE / sizeof(uint32_t)])
+{
+	// Program-only write (bits that are already cleared stay cleared)
+	for (uint32_t i = 0u; i < HAL_NV_PAGE_SIZE / sizeof(uint32_t); ++i)
+	{
+		scratch[i] = UINT32_C(0xFFFFFFFF);
+	}
+
+	// Clear the lowest bit that is still set (the page must not be exhausted)
+	uint32_t i = 0u;
+	while (page[i] == 0u)
+	{
+		++i;
+	}
+
+	scratch[i] = page[i] & (page[i] - 1u);
+
+	return Hal_NvProgram((const void *) page, (const uint8_t *) scratch);
+}
+#endif
+
+//---------------------------------------------------------------------------------------------------------------------
+static const uint8_t kTag_Quote[4u]    = "QUOT";
+static const uint8_t kTag_HmacKdf[4u]  = "HKDF";
+
+#if (CONFIG_CRYPTOMEM_KEY_CACHE == CONFIG_CRYPTOMEM_KEY_CACHE_RAM)
+/**
+ * @brief RAM cache of the keyed HMAC states of the device-specific keys
+ */
+typedef struct
+{
+	/**
+	 * @brief Keyed HMAC states (indexed by device key)
+	 */
+	Sha256_HmacState_t state[kCryptoMem_NumDeviceKeys];
+
+	/**
+	 * @brief Indicates that the cached HMAC states are valid.
+	 */
+	bool valid;
+} CryptoMem_KeyCache_t;
+
+/**
+ * @brief Keyed HMAC state cache
+ */
+static CryptoMem_KeyCache_t gKeyCache;
+#elif (CONFIG_CRYPTOMEM_KEY_CACHE == CONFIG_CRYPTOMEM_KEY_CACHE_NV)
+/**
+ * @brief Indicates that the keyed HMAC states in NV match the device configuration page
+ *
+ * The states are bound to page 0 by recomputing them at startup (a reset between the write of page 0 and the
+ * rewrite of the states leaves stale states behind). The device keys are derived on every use until the states
+ * have been rewritten successfully.
+ */
+static bool gKeyStateValid;
+#endif
+
+#if (CONFIG_CRYPTOMEM_COMPOSITE_PCR != 0)
+/**
+ * @brief Composite digest over the PCR bank
+ */
+typedef struct
+{
+	/**
+	 * @brief Composite digest (SHA-256 of PCR_0 || PCR_1 || PCR_2)
+	 */
+	uint8_t digest[SHA256_HASH_LENGTH_BYTES];
+
+	/**
+	 * @brief Indicates that the composite digest matches the current PCR bank.
+	 */
+	bool valid;
+} CryptoMem_CompositePcr_t;
+
+/**
+ * @brief Composite PCR digest (recomputed on demand after extends)
+ */
+static CryptoMem_CompositePcr_t gCompositePcr;
+#endif
+
+#if (CONFIG_CRYPTOMEM_SESSION != 0)
+/**
+ * @brief Streaming hash session
+ */
+typedef struct
+{
+	/**
+	 * @brief SHA-256 context of the session (kept alive across commands)
+	 */
+	Sha256_Ctx_t ctx;
+
+	/**
+	 * @brief Total number of bytes hashed in the session
+	 */
+	uint32_t length;
+
+	/**
+	 * @brief Indicates that a session is active.
+	 */
+	bool active;
+} CryptoMem_Session_t;
+
+/**
+ * @brief Streaming hash session state
+ */
+static CryptoMem_Session_t gSession;
+#endif
+
+#if (CONFIG_CRYPTOMEM_QUOTE_CACHE != 0)
+/**
+ * @brief Cached quote prefix
+ */
+typedef struct
+{
+	/**
+	 * @brief HMAC context after the quote prefix
+	 */
+	Sha256_Ctx_t ctx;
+
+	/**
+	 * @brief Device state generation of the cached quote prefix
+	 */
+	uint32_t generation;
+
+	/**
+	 * @brief Quote bitmask of the cached quote prefix
+	 */
+	uint32_t pcr_mask;
+
+	/**
+	 * @brief Indicates that the cached quote prefix is valid.
+	 */
+	bool valid;
+} CryptoMem_QuoteCache_t;
+
+/**
+ * @brief Quote prefix cache
+ */
+static CryptoMem_QuoteCache_t gQuoteCache;
+#endif
+
+#if (CONFIG_CRYPTOMEM_TELEMETRY != 0)
+/**
+ * @brief Commands with individual telemetry records (all other commands share the last record)
+ */
+static const uint8_t kTelemetryCommands[] =
+{
+	0xA0u, 0xB0u, 0xB1u, 0xC0u, 0xD0u, 0xE0u, 0xE1u, 0xE4u, 0xE5u, 0xE6u, 0xF1u, 0xF3u
+};
+
+/**
+ * @brief Telemetry record of a command
+ */
+typedef struct
+{
+	/**
+	 * @brief Number of executions (modulo 2^16)
+	 */
+	uint16_t count;
+
+	/**
+	 * @brief Number of executions with a non-zero return code (modulo 2^16)
+	 */
+	uint16_t errors;
+
+	/**
+	 * @brief Execution time of the last execution (in core clock cycles)
+	 */
+	uint32_t last_cycles;
+
+	/**
+	 * @brief Maximum execution time (in core clock cycles)
+	 */
+	uint32_t max_cycles;
+
+	/**
+	 * @brief Accumulated ISR time during executions (in core clock cycles)
+	 */
+	uint32_t isr_cycles;
+} CryptoMem_Telemetry_t;
+
+/**
+ * @brief Telemetry records (indexed like kTelemetryCommands, followed by the shared record)
+ */
+static CryptoMem_Telemetry_t gTelemetry[sizeof(kTelemetryCommands) + 1u];
+#endif
+
+//---------------------------------------------------------------------------------------------------------------------
+static bool CryptoMem_IsDeviceUnlocked(void)
+{
+	return (gNv.page0.NV_UNLOCK_MARKER == UINT32_C(0xAACCEE55));
+}
+
+
+//---------------------------------------------------------------------------------------------------------------------
+static void CryptoMem_DeriveDeviceKey(uint8_t key[SHA256_HASH_LENGTH_BYTES], const volatile uint8_t seed[8u], const uint8_t type[4u])
+{
+	// First derive the device-specific key
+	//  key = HMAC_{ROOT_KEY} ( seed || type )
+
+	// Construct the input block:
+	for (uint32_t i = 0u; i < 8u; ++i)
+	{
+		key[i] = seed[i];
+	}
+
+	__UNALIGNED_UINT32_WRITE(&key[ 8u], __UNALIGNED_UINT32_READ(&type[0u]));
+
+	// Derive the key (via HMAC)
+	Sha256_HmacInit(gNv.page0.ROOT_KEY, sizeof(gNv.page0.ROOT_KEY));
+	Sha256_HmacUpdate(key, 8u + 4u);
+	Sha256_HmacFinal(key);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+static void CryptoMem_HmacInitFromDerivedKey(const CryptoMem_DeviceKey_t key_id)
+{
+	uint8_t key[SHA256_HASH_LENGTH_BYTES];
+
+	// Derive the device specific key
+	if (key_id == kCryptoMem_DeviceKeyQuote)
+	{
+		CryptoMem_DeriveDeviceKey(key, &gNv.page0.QUOTE_KEY_SEED[0u], kTag_Quote);
+	}
+	else
+	{
+		CryptoMem_DeriveDeviceKey(key, &gNv.page0.HKDF_KEY_SEED[0u], kTag_HmacKdf);
+	}
+
+	// Next initialize the HMAC
+	Sha256_HmacInit(key, SHA256_HASH_LENGTH_BYTES);
+
+	// And clear the derived key
+	__builtin_memset(key, 0u, sizeof(key));
+}
+
+#if (CONFIG_CRYPTOMEM_KEY_CACHE == CONFIG_CRYPTOMEM_KEY_CACHE_NV)
+//---------------------------------------------------------------------------------------------------------------------
+static bool CryptoMem_WriteKeyStates(void)
+{
+	// Recompute the keyed HMAC states for the current device keys (using the DATA area as scratch buffer; pages that
+	// already hold the right state are not rewritten)
+	Sha256_HmacState_t *const state = (Sha256_HmacState_t *) &gIoMem.regs.DATA[0u];
+
+	for (uint32_t i = 0u; i < kCryptoMem_NumDeviceKeys; ++i)
+	{
+		CryptoMem_HmacInitFromDerivedKey((CryptoMem_DeviceKey_t) i);
+		Sha256_HmacExportState(state);
+
+		if (!Hal_NvWrite(&gNv.KEY_STATE[i], (const uint8_t *) state))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+#endif
+
+#if (CONFIG_CRYPTOMEM_KEY_CACHE == CONFIG_CRYPTOMEM_KEY_CACHE_RAM)
+//---------------------------------------------------------------------------------------------------------------------
+static void CryptoMem_FillKeyCache(void)
+{
+	for (uint32_t i = 0u; i < kCryptoMem_NumDeviceKeys; ++i)
+	{
+		CryptoMem_HmacInitFromDerivedKey((CryptoMem_DeviceKey_t) i);
+		Sha256_HmacExportState(&gKeyCache.state[i]);
+	}
+
+	gKeyCache.valid = true;
+}
+#endif
+
+//---------------------------------------------------------------------------------------------------------------------
+static void CryptoMem_HmacInitFromDeviceKey(const CryptoMem_DeviceKey_t key_id)
+{
+#if (CONFIG_CRYPTOMEM_KEY_CACHE == CONFIG_CRYPTOMEM_KEY_CACHE_RAM)
+	// Refill the cache (if it has been invalidated by an NV write)
+	if (!gKeyCache.valid)
+	{
+		CryptoMem_FillKeyCache();
+	}
+
+	// Resume the HMAC from the cached keyed state
+	Sha256_HmacImportState(&gKeyCache.state[key_id]);
+#elif (CONFIG_CRYPTOMEM_KEY_CACHE == CONFIG_CRYPTOMEM_KEY_CACHE_NV)
+	if (gKeyStateValid)
+	{
+		// Resume the HMAC from the precomputed keyed state (in NV)
+		Sha256_HmacImportState(&gNv.KEY_STATE[key_id]);
+	}
+	else
+	{
+		// The states in NV are stale (derive the key and initialize the HMAC)
+		CryptoMem_HmacInitFromDerivedKey(key_id);
+	}
+#else
+	// Derive the key and initialize the HMAC
+	CryptoMem_HmacInitFromDerivedKey(key_id);
+#endif
+}
+
+#if (CONFIG_CRYPTOMEM_QUOTE_CACHE != 0)
+//---------------------------------------------------------------------------------------------------------------------
+static void CryptoMem_HmacInitCtxFromDeviceKey(Sha256_Ctx_t *const ctx, const CryptoMem_DeviceKey_t key_id)
+{
+#if (CONFIG_CRYPTOMEM_KEY_CACHE == CONFIG_CRYPTOMEM_KEY_CACHE_RAM)
+	// Refill the cache (if it has been invalidated by an NV write)
+	if (!gKeyCache.valid)
+	{
+		CryptoMem_FillKeyCache();
+	}
+
+	// Resume the HMAC from the cached keyed state
+	Sha256_HmacImportStateCtx(ctx, &gKeyCache.state[key_id]);
+#else
+#if (CONFIG_CRYPTOMEM_KEY_CACHE == CONFIG_CRYPTOMEM_KEY_CACHE_NV)
+	if (gKeyStateValid)
+	{
+		// Resume the HMAC from the precomputed keyed state (in NV)
+		Sha256_HmacImportStateCtx(ctx, &gNv.KEY_STATE[key_id]);
+		return;
+	}
+#endif
+
+	// Derive the device specific key (with the global engine) and initialize the HMAC
+	uint8_t key[SHA256_HASH_LENGTH_BYTES];
+
+	if (key_id == kCryptoMem_DeviceKeyQuote)
+	{
+		CryptoMem_DeriveDeviceKey(key, &gNv.page0.QUOTE_KEY_SEED[0u], kTag_Quote);
+	}
+	else
+	{
+		CryptoMem_DeriveDeviceKey(key, &gNv.page0.HKDF_KEY_SEED[0u], kTag_HmacKdf);
+	}
+
+	Sha256_HmacInitCtx(ctx, key, SHA256_HASH_LENGTH_BYTES);
+	__builtin_memset(key, 0u, sizeof(key));
+#endif
+}
+#endif
+
+//---------------------------------------------------------------------------------------------------------------------
+/**
+ * @brief Signals a change of the device state (PCRs, counters, volatile bits and locks, or NV data).
+ *
+ * The state generation register is incremented after the state has changed (hosts that read the generation before the
+ * state never cache stale values).
+ *
+ * @remarks This function is also called from the EEP write callback (in interrupt context). An increment from thread
+ *   mode may race with an interrupt, but any race still leaves the generation changed (which is all that the quote
+ *   cache and polling hosts need).
+ */
+static inline void CryptoMem_StateChanged(void)
+{
+#if (CONFIG_CRYPTOMEM_STATE_GENERATION != 0)
+	gIoMem.regs.STATE_GENERATION = gIoMem.regs.STATE_GENERATION + 1u;
+#endif
+}
+
+#if (CONFIG_CRYPTOMEM_COMPOSITE_PCR != 0)
+//---------------------------------------------------------------------------------------------------------------------
+static const uint8_t* CryptoMem_GetCompositePcr(void)
+{
+	// Recompute the composite digest (if the PCR bank has been extended since the last calculation)
+	if (!gCompositePcr.valid)
+	{
+		Sha256_Init();
+		Sha256_Update(&gIoMem.regs.PCR[0u][0u], sizeof(gIoMem.regs.PCR));
+		Sha256_Final(&gCompositePcr.digest[0u]);
+
+		gCompositePcr.valid = true;
+	}
+
+	return &gCompositePcr.digest[0u];
+}
+#endif
+
+#if (CONFIG_CRYPTOMEM_REGISTER_MAP_V2 != 0)
+//---------------------------------------------------------------------------------------------------------------------
+static uint8_t CryptoMem_MapV2Address(uint8_t address, bool write)
+{
+	// Translates an address in the command window of the register map v2 to the default register map (DATA and
+	// ARG_0-ARG_2 are at the same addresses in both maps)
+	if (address < IOMEM_V2_OFF_CMD_STAT)
+	{
+		return address;
+	}
+	else if (address == IOMEM_V2_OFF_CMD_STAT)
+	{
+		return write ? IOMEM_REG_OFF(CMD) : IOMEM_REG_OFF(STAT);
+	}
+	else if (address < IOMEM_V2_OFF_RSP_LEN)
+	{
+		return (uint8_t) (IOMEM_REG_OFF(RET_0) + (address - IOMEM_V2_OFF_RET));
+	}
+	else
+	{
+		// Read-only (handled by the read callback; writes go to the read-only STAT register)
+		return IOMEM_REG_OFF(STAT);
+	}
+}
+#endif
+
+//---------------------------------------------------------------------------------------------------------------------
+uint8_t Eep_ByteReadCallback(uint8_t address)
+{
+#if (CONFIG_CRYPTOMEM_REGISTER_MAP_V2 != 0)
+	if (gRegMapV2 && (address < IOMEM_REG_OFF(VOLATILE_BITS)))
+	{
+		// The complete command window reads as IOMEM_STAT_BUSY (0xFF) while a command is ongoing
+		if (gCommandActive)
+		{
+			return UINT8_C(0xFF);
+		}
+
+		if (address == IOMEM_V2_OFF_RSP_LEN)
+		{
+			return gRegMapV2RspLength;
+		}
+
+		return gIoMem.raw[CryptoMem_MapV2Address(address, false)];
+	}
+#endif
+
+	if (address <= IOMEM_REG_OFF(STAT))
+	{
+		// Addresses less or equal to the state register read as IOMEM_STAT_BUSY (0xFF) while a command is ongoing
+		if (gCommandActive)
+		{
+			return UINT8_C(0xFF);
+		}
+	}
+
+	return gIoMem.raw[address];
+}
+
+#if (CONFIG_CRYPTOMEM_REGISTER_MAP_V2 != 0)
+//---------------------------------------------------------------------------------------------------------------------
+uint8_t Eep_NextReadAddressCallback(uint8_t address)
+{
+	// Sequential reads in the command window of the register map v2 wrap from RSP_LEN to the start of DATA (the
+	// completion status and the response data are polled with a single read)
+	if (gRegMapV2 && (address == IOMEM_V2_OFF_RSP_LEN))
+	{
+		return IOMEM_REG_OFF(DATA);
+	}
+
+	return (uint8_t) (address + 1u);
+}
+#endif
+
+#if (CONFIG_CRYPTOMEM_STAGING != 0)
+//---------------------------------------------------------------------------------------------------------------------
+static void CryptoMem_StageWrite(uint8_t address, uint8_t data)
+{
+	// The staging bank is sealed once a command has been staged
+	if ((gIoMem.regs.STAGE_STAT & IOMEM_STAGE_STAT_START) == 0u)
+	{
+		gStaging[address] = data;
+
+		gIoMem.regs.STAGE_STAT = (address == IOMEM_REG_OFF(CMD)) ?
+			(IOMEM_STAGE_STAT_DATA | IOMEM_STAGE_STAT_START) : IOMEM_STAGE_STAT_DATA;
+	}
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+static void CryptoMem_StageMerge(void)
+{
+	// Swap in the staged DATA and ARG registers (and clear the staging bank for the next command)
+	__builtin_memcpy(&gIoMem.raw[0u], &gStaging[0u], IOMEM_REG_OFF(CMD));
+	__builtin_memset(&gStaging[0u], 0u, sizeof(gStaging));
+	gIoMem.regs.STAGE_STAT = 0u;
+}
+#endif
+
+//---------------------------------------------------------------------------------------------------------------------
+void Eep_ByteWriteCallback(uint8_t address, uint8_t data)
+{
+#if (CONFIG_CRYPTOMEM_REGISTER_MAP_V2 != 0)
+	if (gRegMapV2 && (address < IOMEM_REG_OFF(VOLATILE_BITS)))
+	{
+		// Command window of the register map v2
+		address = CryptoMem_MapV2Address(address, true);
+	}
+#endif
+
+	// Write access is only allowed when no command is active
+	//
+	// Any writes to the CMD register trigger activation of a command
+	switch (address)
+	{
+	case IOMEM_REG_OFF(CMD):
+		if (!gCommandActive)
+		{
+#if (CONFIG_CRYPTOMEM_STAGING != 0)
+			if (gIoMem.regs.STAGE_STAT != 0u)
+			{
+				// The staged data (of a command that was not started) is the input of this command
+				CryptoMem_StageMerge();
+			}
+#endif
+
+			// Update the status and RET registers (this ensures that we __always__ read consistent values
+			// even if the next I2C read interrupt comes before we dispatch)
+			gIoMem.regs.CMD = data;
+			gIoMem.regs.STAT = IOMEM_STAT_BUSY;
+			gIoMem.regs.RET_0 = 0u;
+			gIoMem.regs.RET_1 = 0u;
+			gIoMem.regs.RET_2 = 0u;
+
+			// Write to the CMD register (activate a new command) and update
+			gCommandActive = true;
+
+			// Issue memory barrier (also for compiler) and set the event flag
+			__DMB();
+			__SEV();
+		}
+#if (CONFIG_CRYPTOMEM_STAGING != 0)
+		else
+		{
+			// Stage the command (started when the current command completes)
+			CryptoMem_StageWrite(address, data);
+		}
+#endif
+		break;
+
+	case IOMEM_REG_OFF(VOLATILE_LOCKS) + 0u:
+	case IOMEM_REG_OFF(VOLATILE_LOCKS) + 1u:
+	case IOMEM_REG_OFF(VOLATILE_LOCKS) + 2u:
+	case IOMEM_REG_OFF(VOLATILE_LOCKS) + 3u:
+		// Update volatile lock bits (allow toggle from 0->1)
+		{
+			const uint8_t old_lock = gIoMem.raw[address];
+			gIoMem.raw[address] = (uint8_t) (old_lock | data);
+		}
+
+		CryptoMem_StateChanged();
+		break;
+
+	case IOMEM_REG_OFF(VOLATILE_BITS) + 0u:
+	case IOMEM_REG_OFF(VOLATILE_BITS) + 1u:
+	case IOMEM_REG_OFF(VOLATILE_BITS) + 2u:
+	case IOMEM_REG_OFF(VOLATILE_BITS) + 3u:
+		// Update volatile value bits (allow value changes only where lock bit is 0)
+		//
+		{
+			const uint8_t lock_mask = gIoMem.raw[address - IOMEM_REG_OFF(VOLATILE_BITS) + IOMEM_REG_OFF(VOLATILE_LOCKS)];
+			const uint8_t old_value = gIoMem.raw[address];
+
+			gIoMem.raw[address] = (uint8_t) ((old_value & lock_mask) | (data & ~lock_mask));
+		}
+
+		CryptoMem_StateChanged();
+		break;
+
+#if (CONFIG_CRYPTOMEM_COUNTER_ALIAS != 0)
+	case IOMEM_REG_OFF(CTR_INC) + 0u:
+	case IOMEM_REG_OFF(CTR_INC) + 1u:
+		// Increment the volatile counter (discard the increment on overflow)
+		{
+			const uint32_t counter_index = address - IOMEM_REG_OFF(CTR_INC);
+			const uint32_t old_value = gIoMem.regs.VOLATILE_COUNTER[counter_index];
+
+			if ((UINT32_MAX - old_value) < data)
+			{
+				// Counter overflow
+				gIoMem.regs.CTR_OVF |= (uint8_t) (1u << counter_index);
+			}
+			else
+			{
+				gIoMem.regs.VOLATILE_COUNTER[counter_index] = old_value + data;
+				CryptoMem_StateChanged();
+			}
+		}
+		break;
+
+	case IOMEM_REG_OFF(CTR_OVF):
+		// Clear the overflow flags (write one to clear)
+		gIoMem.regs.CTR_OVF &= (uint8_t) ~data;
+		break;
+#endif
+
+	default:
+		// Allow the write if the address is below the "STAT" field
+		if (address < IOMEM_REG_OFF(STAT))
+		{
+			if (!gCommandActive)
+			{
+#if (CONFIG_CRYPTOMEM_STAGING != 0)
+				if (gIoMem.regs.STAGE_STAT != 0u)
+				{
+					// The host has moved on from the response data (merge the pending staged data first)
+					CryptoMem_StageMerge();
+				}
+#endif
+
+				// Update the raw view of the I/O memory space
+				gIoMem.raw[address] = data;
+			}
+#if (CONFIG_CRYPTOMEM_STAGING != 0)
+			else
+			{
+				// Update the staging bank
+				CryptoMem_StageWrite(address, data);
+			}
+#endif
+		}
+		break;
+	}
+}
+
+
+//---------------------------------------------------------------------------------------------------------------------
+void CryptoMem_Init(void)
+{
+	// I setup of the I/O memory structure
+	__builtin_memset(&gIoMem, 0u, sizeof(gIoMem));
+
+	// Latch the device ID
+	Hal_ReadDeviceID(&gIoMem.regs.DEVICE_UID[0u]);
+
+	gIoMem.regs.STAT = IOMEM_STAT_READY; // We are ready for operation
+	gCommandActive = false; // No commands are active
+
+	// Initialize the lockable bits from NV
+	gIoMem.regs.VOLATILE_BITS  = gNv.page0.NV_VOLATILE_BITS_INIT;
 	gIoMem.regs.VOLATILE_LOCKS = gNv.page0.NV_VOLATILE_LOCKS_INIT;
 
+#if (CONFIG_CRYPTOMEM_NV_LOG_SLOTS != 0)
+	// Locate the newest NV user data record
+	CryptoMem_NvLogInit();
+#endif
+
+#if (CONFIG_CRYPTOMEM_NV_COUNTER != 0)
+	// Load the flash-backed monotonic counters
+	gNvCounter[0u] = CryptoMem_NvCounterRead(0u);
+	gNvCounter[1u] = CryptoMem_NvCounterRead(1u);
+#endif
+
 	// Copy user data from NV
-	__builtin_memcpy(&gIoMem.regs.USER_DATA[0u], &gNv.page1.NV_USER_DATA[0u], sizeof(gIoMem.regs.USER_DATA));
+	__builtin_memcpy(&gIoMem.regs.USER_DATA[0u], &CRYPTOMEM_NV_USER_DATA[0u], sizeof(gIoMem.regs.USER_DATA));
+
+#if (CONFIG_CRYPTOMEM_REGISTER_MAP_V2 != 0)
+	// Select the register map (takes effect before the wired interface is started)
+	gRegMapV2 = (gNv.page0.NV_SYS_CFG.bits.REG_MAP_V2 != 0u);
+	gRegMapV2RspLength = 0u;
+#endif
+
+#if (CONFIG_CRYPTOMEM_COMPOSITE_PCR != 0)
+	// The composite PCR digest is computed on first use
+	gCompositePcr.valid = false;
+#endif
+
+#if (CONFIG_CRYPTOMEM_KEY_CACHE == CONFIG_CRYPTOMEM_KEY_CACHE_RAM)
+	// Precompute the keyed HMAC states of the device keys
+	CryptoMem_FillKeyCache();
+#elif (CONFIG_CRYPTOMEM_KEY_CACHE == CONFIG_CRYPTOMEM_KEY_CACHE_NV)
+	// Check the keyed HMAC states in NV against the device configuration page (and repair stale states)
+	gKeyStateValid = CryptoMem_WriteKeyStates();
+	__builtin_memset(&gIoMem.regs.DATA[0u], 0u, sizeof(gIoMem.regs.DATA));
+#endif
+
+#if (CONFIG_CRYPTOMEM_BENCHMARK != 0) || (CONFIG_CRYPTOMEM_TELEMETRY != 0)
+	// Start the (free-running) cycle counter for execution time measurements
+	Hal_StartCycleCounter();
+#endif
 }
 
 //---------------------------------------------------------------------------------------------------------------------
@@ -484,12 +1476,15 @@ static void CryptoMem_CompleteCommandWithData(uint8_t result)
 {
 	// Clear the data area
 	__builtin_memset(&gIoMem.regs.DATA[0] + gResponseLength, 0, sizeof(gIoMem.regs.DATA) - gResponseLength);
+#if (CONFIG_CRYPTOMEM_REGISTER_MAP_V2 != 0)
+	gRegMapV2RspLength = (uint8_t) gResponseLength;
+#endif
 	gResponseLength = 0u;
 
 	// Clear the command
 	gIoMem.regs.CMD = 0u;
 
-	// RET_1 is currently not used
+	// RET_1 is set by the command handler (if used)
 	gIoMem.regs.RET_0 = result;
 
 	// Copy ARG_2 to RET_2
@@ -498,11 +1493,46 @@ static void CryptoMem_CompleteCommandWithData(uint8_t result)
 	gIoMem.regs.ARG_1 = 0u;
 	gIoMem.regs.ARG_2 = 0u;
 
+#if (CONFIG_CRYPTOMEM_STAGING != 0)
+	// Block IRQs (no staging writes while the staging bank is swapped in)
+	__disable_irq();
+
+	if ((gIoMem.regs.STAGE_STAT & IOMEM_STAGE_STAT_START) != 0u)
+	{
+		if (result == 0x00u)
+		{
+			// Swap in the staged command and start it right away (the device stays busy)
+			const uint8_t staged_cmd = gStaging[IOMEM_REG_OFF(CMD)];
+			CryptoMem_StageMerge();
+
+			gIoMem.regs.CMD = staged_cmd;
+			gIoMem.regs.RET_0 = 0u;
+			gIoMem.regs.RET_1 = 0u;
+			gIoMem.regs.RET_2 = 0u;
+
+			__enable_irq();
+			return;
+		}
+
+		// Drop the staged command (the staged data stays pending and does not overwrite the response data)
+		gIoMem.regs.STAGE_STAT = IOMEM_STAGE_STAT_DATA;
+	}
+#endif
+
+#if (CONFIG_CRYPTOMEM_CLOCK_SCALING != 0)
+	// Back to the default clock before the response is published (a staged command keeps the fast clock)
+	Hal_SetFastClock(false);
+#endif
+
 	// Signal that we are ready again
 	gIoMem.regs.STAT = IOMEM_STAT_READY;
 	__DMB();
 
 	gCommandActive = false;
+
+#if (CONFIG_CRYPTOMEM_STAGING != 0)
+	__enable_irq();
+#endif
 }
 
 //---------------------------------------------------------------------------------------------------------------------
@@ -511,15 +1541,43 @@ static void CryptoMem_SetResponseLength(uint32_t length)
 	gResponseLength = length;
 }
 
+//---------------------------------------------------------------------------------------------------------------------
+static void CryptoMem_ExtendPcr(const uint32_t pcr_index, const uint8_t *const data, const uint32_t data_len)
+{
+	// Compute the new PCR value
+#if (CONFIG_CRYPTOMEM_FAST_EXTEND != 0)
+	Sha256_Extend(&gIoMem.regs.PCR[pcr_index][0], data, data_len);
+#else
+	Sha256_Init();
+	Sha256_Update(&gIoMem.regs.PCR[pcr_index][0], SHA256_HASH_LENGTH_BYTES);
+	Sha256_Update(data, data_len);
+	Sha256_Final(&gIoMem.regs.PCR[pcr_index][0]);
+#endif
+
+#if (CONFIG_CRYPTOMEM_COMPOSITE_PCR != 0)
+	// The composite PCR digest is recomputed on its next use
+	gCompositePcr.valid = false;
+#endif
+
+	CryptoMem_StateChanged();
+}
+
 //---------------------------------------------------------------------------------------------------------------------
 //
 // Command: 0xE0 - Extend PCR
 //   Input:
 //     ARG_0: Target PCR Index and additional data to be extended
-//      [7:4] Reserved (must be zero; non-zero values trigger a parameter error)
+//      [7:6] Reserved (must be zero; non-zero values trigger a parameter error)
+//      [5]   Digest list mode (CONFIG_CRYPTOMEM_VECTOR_EXTEND builds only; must be zero otherwise)
+//              0 - The data is extended as a single measurement
+//              1 - The data is a list of 32-byte digests; each digest is extended separately (in order)
+//      [4]   PCR selection mode (CONFIG_CRYPTOMEM_VECTOR_EXTEND builds only; must be zero otherwise)
+//              0 - ARG_0[3:0] is the target PCR index
+//              1 - ARG_0[2:0] is a bitmask of target PCRs (ARG_0[3] must be zero; at least one PCR must be selected)
 //      [3:0] Target PCR index (valid indices are 0-2, invalid indices trigger a parameter error)
 //
-//     ARG_1: Length of data to be extended (0-80 bytes; data provided in DATA field)
+//     ARG_1: Length of data to be extended (0-80 bytes; data provided in DATA field). In digest list mode the length
+//       must be 32 or 64 bytes.
 //
 //  Output:
 //     RET_0: Return code from command
@@ -533,61 +1591,100 @@ static uint8_t CryptoMem_HandleExtend(void)
 	const uint8_t pcr_index = gIoMem.regs.ARG_0;
 	const uint8_t extend_len = gIoMem.regs.ARG_1;
 
+#if (CONFIG_CRYPTOMEM_VECTOR_EXTEND != 0)
+	const uint32_t pcr_mask = ((pcr_index & 0x10u) != 0u) ? (pcr_index & 0x0Fu) : (UINT32_C(1) << (pcr_index & 0x0Fu));
+	const uint32_t chunk_len = ((pcr_index & 0x20u) != 0u) ? SHA256_HASH_LENGTH_BYTES : extend_len;
+
+	if (((pcr_index & 0xC0u) != 0u) || (pcr_mask == 0u) || (pcr_mask > 0x07u) || (extend_len > sizeof(gIoMem.regs.DATA)) ||
+		((chunk_len != extend_len) && ((extend_len == 0u) || ((extend_len % chunk_len) != 0u))))
+	{
+		// Parameter error
+		return 0xE1u;
+	}
+
+	// Extend the data (or each digest of the list) into all selected PCRs
+	for (uint32_t i = 0u; i < 3u; ++i)
+	{
+		if (((pcr_mask >> i) & 1u) != 0u)
+		{
+			uint32_t offset = 0u;
+
+			do
+			{
+				CryptoMem_ExtendPcr(i, &gIoMem.regs.DATA[offset], chunk_len);
+				offset += chunk_len;
+			} while (offset < extend_len);
+		}
+	}
+#else
 	if ((pcr_index > 2) || (extend_len > sizeof(gIoMem.regs.DATA)))
 	{
 		// Parameter error
 		return 0xE1u;
 	}
 
-	// Compute the new PCR value
-	Sha256_Init();
-	Sha256_Update(&gIoMem.regs.PCR[pcr_index][0], SHA256_HASH_LENGTH_BYTES);
-	Sha256_Update(&gIoMem.regs.DATA[0], extend_len);
-	Sha256_Final(&gIoMem.regs.PCR[pcr_index][0]);
+	CryptoMem_ExtendPcr(pcr_index, &gIoMem.regs.DATA[0], extend_len);
+#endif
 
 	return 0x00u;
 }
 
 //---------------------------------------------------------------------------------------------------------------------
 //
-// Command: 0xA0 - Quote PCRs
+// Command: 0xE1 - Read composite PCR digest
 //   Input:
-//     ARG_0: PCR bitmask to be quoted
-//        [7] Include the device UUID
-//        [6] Include the lockable (volatile) bits
-//        [5] Include the lockable (volatile) counter #1
-//        [4] Include the lockable (volatile) counter #0
-//        [3] Include NV user data area
-//        [2] Include PCR #2
-//        [1] Include PCR #1
-//        [0] Include PCR #0
-//
-//     ARG_1: Length of data to be included from the DATA area (0-80 bytes; data provided in DATA field)
+//     ARG_0: Reserved (ignored; should be zero)
+//     ARG_1: Reserved (ignored; should be zero)
 //
 //  Output:
 //     RET_0: Return code from command
 //          0x00 - Command completed successfully
-//          0xE1 - Parameter error
+//          0xEF - Command not supported in this build
 //
 //     RET_1: Reserved (set to zero)
 //
-static uint8_t CryptoMem_HandleQuote(void)
+//     DATA[255:0]: Composite PCR digest, SHA-256(PCR_0 || PCR_1 || PCR_2)
+//
+static uint8_t CryptoMem_HandleReadCompositePcr(void)
 {
-	const uint8_t pcr_mask = gIoMem.regs.ARG_0;
-	const uint8_t extend_len = gIoMem.regs.ARG_1;
+#if (CONFIG_CRYPTOMEM_COMPOSITE_PCR != 0)
+	__builtin_memcpy(&gIoMem.regs.DATA[0u], CryptoMem_GetCompositePcr(), SHA256_HASH_LENGTH_BYTES);
 
-	if (extend_len > sizeof(gIoMem.regs.DATA))
-	{
-		// Parameter error
-		return 0xE1u;
-	}
+	CryptoMem_SetResponseLength(SHA256_HASH_LENGTH_BYTES);
+	return 0x00u;
+#else
+	// Not supported in this build
+	return 0xEFu;
+#endif
+}
+
+#if (CONFIG_CRYPTOMEM_QUOTE_CACHE != 0)
+// The quote prefix is computed in the quote cache
+# define CRYPTOMEM_QUOTE_HMAC_INIT()            CryptoMem_HmacInitCtxFromDeviceKey(&gQuoteCache.ctx, kCryptoMem_DeviceKeyQuote)
+# define CRYPTOMEM_QUOTE_HMAC_UPDATE(data, size) Sha256_HmacUpdateCtx(&gQuoteCache.ctx, (data), (size))
+#else
+// The quote prefix is computed by the global HMAC engine
+# define CRYPTOMEM_QUOTE_HMAC_INIT()            CryptoMem_HmacInitFromDeviceKey(kCryptoMem_DeviceKeyQuote)
+# define CRYPTOMEM_QUOTE_HMAC_UPDATE(data, size) Sha256_HmacUpdate((data), (size))
+#endif
+
+//---------------------------------------------------------------------------------------------------------------------
+/**
+ * @brief Initializes the quote HMAC and absorbs the quote prefix (all data except the extra data).
+ */
+static void CryptoMem_QuotePrefix(const uint32_t pcr_mask)
+{
+#if (CONFIG_CRYPTOMEM_COMPOSITE_PCR != 0)
+	// Bring the composite PCR digest up to date if selected (before the HMAC engine is in use)
+	const uint8_t *const composite_pcr = ((pcr_mask & 0x100u) != 0u) ? CryptoMem_GetCompositePcr() : NULL;
+#endif
 
 	// Quote as HMAC over the PCRs (and extra data - if needed)
-	CryptoMem_HmacInitFromDeviceKey(&gNv.page0.QUOTE_KEY_SEED[0u], kTag_Quote);
+	CRYPTOMEM_QUOTE_HMAC_INIT();
 
 	// "quot" marker, pcr mask and head data
 	{
-		uint32_t header[1u + 1u + 4u + 2u + 2u];
+		uint32_t header[1u + 1u + 4u + 2u + 2u + 2u];
 		uint32_t *item = &header[0];
 
 		// Block IRQs (to ensure that the volatile I/O regs don't change)
@@ -623,37 +1720,154 @@ static uint8_t CryptoMem_HandleQuote(void)
 			*item++ = gIoMem.regs.VOLATILE_COUNTER[0u];
 		}
 
+#if (CONFIG_CRYPTOMEM_NV_COUNTER != 0)
+		// Include the flash-backed monotonic counters
+		if (0u != (pcr_mask & 0x200u))
+		{
+			*item++ = gNvCounter[0u];
+			*item++ = gNvCounter[1u];
+		}
+#endif
+
 		// Enable IRQs again
 		__enable_irq();
 
-		Sha256_HmacUpdate(header, (item - header) * sizeof(uint32_t));
+		CRYPTOMEM_QUOTE_HMAC_UPDATE(header, (item - header) * sizeof(uint32_t));
 	}
 
 	// If enable: MAC the user data area
 	if ((pcr_mask & 0x08u) != 0u)
 	{
-		Sha256_HmacUpdate(&gIoMem.regs.USER_DATA[0u], sizeof(gIoMem.regs.USER_DATA));
+		CRYPTOMEM_QUOTE_HMAC_UPDATE(&gIoMem.regs.USER_DATA[0u], sizeof(gIoMem.regs.USER_DATA));
+	}
+
+#if (CONFIG_CRYPTOMEM_COMPOSITE_PCR != 0)
+	// If enabled: MAC the composite PCR digest
+	if (composite_pcr != NULL)
+	{
+		CRYPTOMEM_QUOTE_HMAC_UPDATE(composite_pcr, SHA256_HASH_LENGTH_BYTES);
 	}
+#endif
 
 	// All selected PCRs
 	for (size_t i = 0u; i < 3u; ++i)
 	{
 		if (((pcr_mask >> i) & 1u) != 0u)
 		{
-			Sha256_HmacUpdate(&gIoMem.regs.PCR[i], SHA256_HASH_LENGTH_BYTES);
+			CRYPTOMEM_QUOTE_HMAC_UPDATE(&gIoMem.regs.PCR[i], SHA256_HASH_LENGTH_BYTES);
 		}
 	}
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+//
+// Command: 0xA0 - Quote PCRs
+//   Input:
+//     ARG_0: PCR bitmask to be quoted
+//        [7] Include the device UUID
+//        [6] Include the lockable (volatile) bits
+//        [5] Include the lockable (volatile) counter #1
+//        [4] Include the lockable (volatile) counter #0
+//        [3] Include NV user data area
+//        [2] Include PCR #2
+//        [1] Include PCR #1
+//        [0] Include PCR #0
+//
+//     ARG_1: Quote options and length of extra data
+//        [7]   Include the composite PCR digest (see command 0xE1; CONFIG_CRYPTOMEM_COMPOSITE_PCR builds only)
+//        [6:0] Length of data to be included from the DATA area (0-80 bytes; data provided in DATA field)
+//
+//  Output:
+//     RET_0: Return code from command
+//          0x00 - Command completed successfully
+//          0xE1 - Parameter error
+//
+//     RET_1: Reserved (set to zero)
+//
+// The quote header MACs the PCR bitmask as 32-bit word. The composite PCR option (ARG_1[7]) is reported as bit 8
+// of this word. The composite digest is MACed after the NV user data area (and before any individually selected PCRs).
+//
+// Command 0xA1 (see below) additionally includes the NV monotonic counters.
+//
+static uint8_t CryptoMem_HandleQuote(const uint32_t options)
+{
+	uint32_t pcr_mask = gIoMem.regs.ARG_0 | options;
+	uint8_t extend_len = gIoMem.regs.ARG_1;
+
+#if (CONFIG_CRYPTOMEM_COMPOSITE_PCR != 0)
+	pcr_mask |= (extend_len & 0x80u) << 1u;
+	extend_len &= 0x7Fu;
+#endif
+
+	if (extend_len > sizeof(gIoMem.regs.DATA))
+	{
+		// Parameter error
+		return 0xE1u;
+	}
+
+#if (CONFIG_CRYPTOMEM_QUOTE_CACHE != 0)
+	// Sample the state generation (before the quote prefix is constructed)
+	const uint32_t generation = gIoMem.regs.STATE_GENERATION;
+
+	if (!gQuoteCache.valid || (gQuoteCache.generation != generation) || (gQuoteCache.pcr_mask != pcr_mask))
+	{
+		// Compute the quote prefix (in the cache)
+		CryptoMem_QuotePrefix(pcr_mask);
+
+		gQuoteCache.generation = generation;
+		gQuoteCache.pcr_mask   = pcr_mask;
+		gQuoteCache.valid      = true;
+	}
+
+	// Complete the quote on a working copy (the cached quote prefix stays intact)
+	Sha256_Ctx_t ctx;
+	__builtin_memcpy(&ctx, &gQuoteCache.ctx, sizeof(ctx));
+
+	Sha256_HmacUpdateCtx(&ctx, &gIoMem.regs.DATA[0], extend_len);
+	Sha256_HmacFinalCtx(&ctx, &gIoMem.regs.DATA[0]);
+#else
+	// Quote as HMAC over the PCRs (and extra data - if needed)
+	CryptoMem_QuotePrefix(pcr_mask);
 
 	// And the user-supplied extra data
 	Sha256_HmacUpdate(&gIoMem.regs.DATA[0], extend_len);
 
 	// Finalize the HMAC
 	Sha256_HmacFinal(&gIoMem.regs.DATA[0]);
+#endif
 
 	CryptoMem_SetResponseLength(SHA256_HASH_LENGTH_BYTES);
 	return 0x00u;
 }
 
+//---------------------------------------------------------------------------------------------------------------------
+//
+// Command: 0xA1 - Quote PCRs and NV counters
+//   Input:
+//     ARG_0: PCR bitmask to be quoted (see command 0xA0)
+//     ARG_1: Quote options and length of extra data (see command 0xA0)
+//
+//  Output:
+//     RET_0: Return code from command
+//          0x00 - Command completed successfully
+//          0xE1 - Parameter error
+//          0xEF - Command not supported in this build
+//
+//     RET_1: Reserved (set to zero)
+//
+// Same as command 0xA0, with bit 9 of the PCR bitmask word set. NV counters #0 and #1 (see command 0xC1) are MACed
+// (as 32-bit words; in this order) after the volatile counters.
+//
+static uint8_t CryptoMem_HandleQuoteNvCounters(void)
+{
+#if (CONFIG_CRYPTOMEM_NV_COUNTER != 0)
+	return CryptoMem_HandleQuote(0x200u);
+#else
+	// Not supported in this build
+	return 0xEFu;
+#endif
+}
+
 //---------------------------------------------------------------------------------------------------------------------
 //
 // Command: 0xB0 - HMAC Key Derivation
@@ -661,41 +1875,293 @@ static uint8_t CryptoMem_HandleQuote(void)
 //     ARG_0: Length of user KDF seed data (0-80 bytes)
 //     ARG_1: Reserved (ignored; should be zero)
 //
-//     DATA: Seed input for key derivation
+//     DATA: Seed input for key derivation
+//
+//
+//  Output:
+//     RET_0: Return code from command
+//          0x00 - Command completed successfully
+//          0xE1 - Parameter error
+//
+//     RET_1: Reserved (set to zero)
+//
+//     DATA: Derived key data
+//
+static uint8_t CryptoMem_HandleHmacKeyDerivation(void)
+{
+	const uint8_t seed_len = gIoMem.regs.ARG_0;
+
+	if (seed_len > sizeof(gIoMem.regs.DATA))
+	{
+		// Parameter error
+		return 0xE1u;
+	}
+
+	// Initialize the HMAC engine with the derivation key
+	CryptoMem_HmacInitFromDeviceKey(kCryptoMem_DeviceKeyHmacKdf);
+
+	// Derive the key as:
+	//
+	//   key := HMAC_{kHKDF} (seed)
+	//
+	Sha256_HmacUpdate(&gIoMem.regs.DATA[0u], seed_len);
+	Sha256_HmacFinal(&gIoMem.regs.DATA[0u]);
+
+	// Return the derived key
+	CryptoMem_SetResponseLength(SHA256_HASH_LENGTH_BYTES);
+	return 0x00u;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+//
+// Command: 0xB1 - Batch HMAC Key Derivation
+//   Input:
+//     ARG_0: Length of each user KDF seed (0-32 bytes)
+//     ARG_1: Derivation mode and size
+//        [7]   Derivation mode
+//                0 - Multiple seeds: one key per seed, key_i := HMAC_{kHKDF} (seed_i) (same keys as command 0xB0)
+//                1 - Counter mode: K(i) := HMAC_{kHKDF} (i || seed), with i as 32-bit big-endian integer starting at 1
+//        [6:0] Multiple seeds: number of seeds (1-2); counter mode: number of bytes to derive (1-80)
+//
+//     DATA: Seeds for key derivation (stored back to back in multiple seed mode)
+//
+//  Output:
+//     RET_0: Return code from command
+//          0x00 - Command completed successfully
+//          0xE1 - Parameter error
+//          0xEF - Command not supported in this build
+//
+//     RET_1: Reserved (set to zero)
+//
+//     DATA: Derived keys (concatenated), or derived key material K(1) || K(2) || K(3) (truncated to the requested size)
+//
+#if (CONFIG_CRYPTOMEM_BATCH_HKDF != 0)
+/**
+ * @brief Keyed HMAC state of the HKDF device key (for batch key derivation)
+ */
+static Sha256_HmacState_t gHkdfState;
+#endif
+
+static uint8_t CryptoMem_HandleBatchHmacKeyDerivation(void)
+{
+#if (CONFIG_CRYPTOMEM_BATCH_HKDF != 0)
+	const uint8_t seed_len = gIoMem.regs.ARG_0;
+	const bool counter_mode = ((gIoMem.regs.ARG_1 & 0x80u) != 0u);
+	const uint32_t count = gIoMem.regs.ARG_1 & 0x7Fu;
+	const uint32_t output_len = counter_mode ? count : (count * SHA256_HASH_LENGTH_BYTES);
+
+	if ((seed_len > SHA256_HASH_LENGTH_BYTES) || (output_len == 0u) || (output_len > sizeof(gIoMem.regs.DATA)) ||
+		(!counter_mode && (count > 2u)))
+	{
+		// Parameter error
+		return 0xE1u;
+	}
+
+	// Initialize the HMAC engine with the derivation key (only once per batch)
+	CryptoMem_HmacInitFromDeviceKey(kCryptoMem_DeviceKeyHmacKdf);
+	Sha256_HmacExportState(&gHkdfState);
+
+	// Derive the output blocks in reverse order (seeds at the start of the DATA area are consumed before the first
+	// output block overwrites them)
+	uint32_t i = (output_len + SHA256_HASH_LENGTH_BYTES - 1u) / SHA256_HASH_LENGTH_BYTES;
+
+	while (i-- > 0u)
+	{
+		const uint32_t offset = i * SHA256_HASH_LENGTH_BYTES;
+		const uint32_t block_len = output_len - offset;
+
+		Sha256_HmacImportState(&gHkdfState);
+
+		if (counter_mode)
+		{
+			const uint32_t counter = __REV(i + 1u);
+
+			Sha256_HmacUpdate(&counter, sizeof(counter));
+			Sha256_HmacUpdate(&gIoMem.regs.DATA[0u], seed_len);
+		}
+		else
+		{
+			Sha256_HmacUpdate(&gIoMem.regs.DATA[i * seed_len], seed_len);
+		}
+
+		if (block_len >= SHA256_HASH_LENGTH_BYTES)
+		{
+			Sha256_HmacFinal(&gIoMem.regs.DATA[offset]);
+		}
+		else
+		{
+			// Truncated block (finalize at the end of the DATA area, and move the output into place)
+			uint8_t *const tail = &gIoMem.regs.DATA[sizeof(gIoMem.regs.DATA) - SHA256_HASH_LENGTH_BYTES];
+
+			Sha256_HmacFinal(tail);
+			__builtin_memmove(&gIoMem.regs.DATA[offset], tail, block_len);
+		}
+	}
+
+	// Return the derived keys
+	CryptoMem_SetResponseLength(output_len);
+	return 0x00u;
+#else
+	// Not supported in this build
+	return 0xEFu;
+#endif
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+//
+// Command: 0xE4 - Begin hash session
+//
+// This command starts a new streaming hash session (an active session is abandoned). Data is added to the session with
+// command 0xE5, and the session is completed with command 0xE6. Other commands can be executed while a session is
+// active.
+//
+// Input:
+//     ARG_0: Reserved (ignored; should be zero)
+//     ARG_1: Reserved (ignored; should be zero)
+//
+// Output:
+//     RET_0: Return code from command
+//          0x00 - Command completed successfully
+//          0xEF - Command not supported in this build
+//
+//     RET_1: Reserved (set to zero)
+//
+static uint8_t CryptoMem_HandleSessionBegin(void)
+{
+#if (CONFIG_CRYPTOMEM_SESSION != 0)
+	Sha256_InitCtx(&gSession.ctx);
+	gSession.length = 0u;
+	gSession.active = true;
+
+	return 0x00u;
+#else
+	// Not supported in this build
+	return 0xEFu;
+#endif
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+//
+// Command: 0xE5 - Update hash session
+//
+// This command adds data to the active hash session. The command does not return any data, but hosts must still
+// wait for its completion (by polling STAT until it reads as ready, and checking RET_0) before writing the next
+// chunk. DATA, ARG and CMD writes during execution are ignored (or, in CONFIG_CRYPTOMEM_STAGING builds, queue at
+// most one further chunk in the staging bank). The device does not detect lost or corrupted chunks. In particular,
+// the total session length returned by command 0xE6 does not reveal a chunk that was hashed with stale DATA (which
+// happens if the DATA writes of a chunk overlap the execution of the previous chunk, but its CMD write does not).
+//
+// Input:
+//     ARG_0: Length of the data (0-80 bytes; data provided in DATA field)
+//     ARG_1: Reserved (ignored; should be zero)
+//
+// Output:
+//     RET_0: Return code from command
+//          0x00 - Command completed successfully
+//          0xE1 - Parameter error
+//          0xE5 - Command not allowed in this device state (no active session)
+//          0xEF - Command not supported in this build
+//
+//     RET_1: Reserved (set to zero)
+//
+static uint8_t CryptoMem_HandleSessionUpdate(void)
+{
+#if (CONFIG_CRYPTOMEM_SESSION != 0)
+	const uint8_t data_len = gIoMem.regs.ARG_0;
+
+	if (data_len > sizeof(gIoMem.regs.DATA))
+	{
+		// Parameter error
+		return 0xE1u;
+	}
+
+	if (!gSession.active)
+	{
+		// No active session
+		return 0xE5u;
+	}
+
+	Sha256_UpdateCtx(&gSession.ctx, &gIoMem.regs.DATA[0u], data_len);
+	gSession.length += data_len;
+
+	return 0x00u;
+#else
+	// Not supported in this build
+	return 0xEFu;
+#endif
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+//
+// Command: 0xE6 - Finish hash session
 //
+// This command completes the active hash session. The resulting SHA-256 digest of the session data is returned, or
+// extended into a PCR, or quoted (as extra data of a quote).
 //
-//  Output:
+// Input:
+//     ARG_0: Completion mode
+//              0x00 - Return the session digest
+//              0x01 - Extend the session digest into a PCR (ARG_1 is the target PCR index)
+//              0x02 - Quote with the session digest as extra data (ARG_1 is the quote bitmask; see command 0xA0)
+//     ARG_1: Target PCR index (mode 0x01) or quote bitmask (mode 0x02); ignored otherwise
+//
+// Output:
 //     RET_0: Return code from command
 //          0x00 - Command completed successfully
 //          0xE1 - Parameter error
+//          0xE5 - Command not allowed in this device state (no active session)
+//          0xEF - Command not supported in this build
 //
 //     RET_1: Reserved (set to zero)
 //
-//     DATA: Derived key data
+//     DATA[255:0]:   Session digest (modes 0x00 and 0x01) or quote (mode 0x02)
+//     DATA[287:256]: Total number of bytes hashed in the session (32-bit little-endian)
 //
-static uint8_t CryptoMem_HandleHmacKeyDerivation(void)
+static uint8_t CryptoMem_HandleSessionFinish(void)
 {
-	const uint8_t seed_len = gIoMem.regs.ARG_0;
+#if (CONFIG_CRYPTOMEM_SESSION != 0)
+	const uint8_t mode = gIoMem.regs.ARG_0;
+	const uint8_t target = gIoMem.regs.ARG_1;
 
-	if (seed_len > sizeof(gIoMem.regs.DATA))
+	if ((mode > 0x02u) || ((mode == 0x01u) && (target > 2u)))
 	{
 		// Parameter error
 		return 0xE1u;
 	}
 
-	// Initialize the HMAC engine with the derivation key
-	CryptoMem_HmacInitFromDeviceKey(&gNv.page0.HKDF_KEY_SEED[0u], kTag_HmacKdf);
+	if (!gSession.active)
+	{
+		// No active session
+		return 0xE5u;
+	}
 
-	// Derive the key as:
-	//
-	//   key := HMAC_{kHKDF} (seed)
-	//
-	Sha256_HmacUpdate(&gIoMem.regs.DATA[0u], seed_len);
-	Sha256_HmacFinal(&gIoMem.regs.DATA[0u]);
+	// Complete the session
+	Sha256_FinalCtx(&gSession.ctx, &gIoMem.regs.DATA[0u]);
+	gSession.active = false;
 
-	// Return the derived key
-	CryptoMem_SetResponseLength(SHA256_HASH_LENGTH_BYTES);
-	return 0x00u;
+	uint8_t status = 0x00u;
+
+	if (mode == 0x01u)
+	{
+		// Extend the session digest into the target PCR
+		CryptoMem_ExtendPcr(target, &gIoMem.regs.DATA[0u], SHA256_HASH_LENGTH_BYTES);
+	}
+	else if (mode == 0x02u)
+	{
+		// Quote with the session digest as extra data
+		gIoMem.regs.ARG_0 = target;
+		gIoMem.regs.ARG_1 = SHA256_HASH_LENGTH_BYTES;
+		status = CryptoMem_HandleQuote(0u);
+	}
+
+	// Return the digest (or quote) and the session length
+	__UNALIGNED_UINT32_WRITE(&gIoMem.regs.DATA[SHA256_HASH_LENGTH_BYTES], gSession.length);
+	CryptoMem_SetResponseLength(SHA256_HASH_LENGTH_BYTES + sizeof(uint32_t));
+	return status;
+#else
+	// Not supported in this build
+	return 0xEFu;
+#endif
 }
 
 //---------------------------------------------------------------------------------------------------------------------
@@ -725,16 +2191,109 @@ static uint8_t CryptoMem_HandleIncrement(void)
 		return 0xE1u;
 	}
 
+#if (CONFIG_CRYPTOMEM_COUNTER_ALIAS != 0)
+	// Block IRQs (the counters can also be incremented from the EEP write callback)
+	__disable_irq();
+#endif
+
 	// Increment the counter
 	const uint32_t old_value = gIoMem.regs.VOLATILE_COUNTER[counter_index];
-	if ((UINT32_MAX - old_value) < increment)
+	const bool overflow = ((UINT32_MAX - old_value) < increment);
+
+	if (!overflow)
+	{
+		gIoMem.regs.VOLATILE_COUNTER[counter_index] = old_value + increment;
+		CryptoMem_StateChanged();
+	}
+
+#if (CONFIG_CRYPTOMEM_COUNTER_ALIAS != 0)
+	__enable_irq();
+#endif
+
+	// Counter overflow?
+	return overflow ? 0xE3u : 0x00u;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+//
+// Command: 0xC1 - Read/Increment NV Counter
+//   Input:
+//     ARG_0: Target counter index (0-1 is valid; invalid index triggers a parameter error)
+//     ARG_1: Operation
+//        0x00 - Read the NV counters
+//        0x01 - Increment the target NV counter by one
+//
+//  Output:
+//     RET_0: Return code from command
+//          0x00 - Command completed successfully
+//          0xE1 - Parameter error
+//          0xE3 - Counter increment failed (counter exhausted)
+//          0xE4 - Command execution failed (flash programming error)
+//          0xEF - Command not supported in this build
+//
+//     RET_1: Reserved (set to zero)
+//
+//     DATA[31: 0]: Value of NV counter #0 (32-bit little-endian)
+//     DATA[63:32]: Value of NV counter #1 (32-bit little-endian)
+//
+// The NV counters are flash-backed monotonic counters (CONFIG_CRYPTOMEM_NV_COUNTER builds only). They keep their
+// values across resets. An increment that is interrupted by a reset may advance the counter by more than one (but
+// never makes it go backwards).
+//
+static uint8_t CryptoMem_HandleNvCounter(void)
+{
+#if (CONFIG_CRYPTOMEM_NV_COUNTER != 0)
+	const uint32_t counter_index = gIoMem.regs.ARG_0;
+	const uint8_t operation = gIoMem.regs.ARG_1;
+
+	if ((counter_index > 1u) || (operation > 0x01u))
+	{
+		// Parameter error
+		return 0xE1u;
+	}
+
+	if (operation == 0x01u)
 	{
-		// Counter overflow
-		return 0xE3u;
+		const CryptoMem_NvCounterPages_t *const pages = &gNvCounterPages[counter_index];
+		uint32_t *const scratch = (uint32_t *) &gIoMem.regs.DATA[0u];
+		const uint32_t units = CryptoMem_NvCounterCountBits(pages->UNITS);
+
+		if (units == CRYPTOMEM_NV_COUNTER_PAGE_BITS)
+		{
+			// The unary page is exhausted: count a rollover first, then erase the unary page
+			const uint32_t rollovers = CryptoMem_NvCounterCountBits(pages->ROLLOVERS);
+
+			if (rollovers == CRYPTOMEM_NV_COUNTER_PAGE_BITS)
+			{
+				// Counter exhausted
+				return 0xE3u;
+			}
+
+			if (!CryptoMem_NvCounterClearBit(pages->ROLLOVERS, scratch) || !Hal_NvErase((const void *) pages->UNITS))
+			{
+				return 0xE4u;
+			}
+		}
+
+		// Clear the next bit of the unary page
+		if (!CryptoMem_NvCounterClearBit(pages->UNITS, scratch))
+		{
+			return 0xE4u;
+		}
+
+		gNvCounter[counter_index] = CryptoMem_NvCounterRead(counter_index);
+		CryptoMem_StateChanged();
 	}
 
-	gIoMem.regs.VOLATILE_COUNTER[counter_index] = old_value + increment;
+	__UNALIGNED_UINT32_WRITE(&gIoMem.regs.DATA[0u], gNvCounter[0u]);
+	__UNALIGNED_UINT32_WRITE(&gIoMem.regs.DATA[4u], gNvCounter[1u]);
+
+	CryptoMem_SetResponseLength(2u * sizeof(uint32_t));
 	return 0x00u;
+#else
+	// Not supported in this build
+	return 0xEFu;
+#endif
 }
 
 //---------------------------------------------------------------------------------------------------------------------
@@ -797,12 +2356,32 @@ static uint8_t CryptoMem_HandleNvWrite(void)
 		// Write to maintenance area
 		if (CryptoMem_IsDeviceUnlocked())
 		{
+#if (CONFIG_CRYPTOMEM_KEY_CACHE == CONFIG_CRYPTOMEM_KEY_CACHE_RAM)
+			// The device keys are about to change (invalidate the key cache)
+			gKeyCache.valid = false;
+#elif (CONFIG_CRYPTOMEM_KEY_CACHE == CONFIG_CRYPTOMEM_KEY_CACHE_NV)
+			// The device keys are about to change (the keyed HMAC states in NV are stale until rewritten)
+			gKeyStateValid = false;
+#endif
+
+			// The quote key is about to change
+			CryptoMem_StateChanged();
+
 			// Write to the flash
 			if (!Hal_NvWrite(&gNv.page0, &gIoMem.regs.DATA[0u]))
 			{
 				return 0xE4;
 			}
 
+#if (CONFIG_CRYPTOMEM_KEY_CACHE == CONFIG_CRYPTOMEM_KEY_CACHE_NV)
+			// Recompute the keyed HMAC states for the new device keys
+			gKeyStateValid = CryptoMem_WriteKeyStates();
+			if (!gKeyStateValid)
+			{
+				return 0xE4;
+			}
+#endif
+
 			// Maintenance operation is done
 			return 0x00u;
 		}
@@ -814,14 +2393,23 @@ static uint8_t CryptoMem_HandleNvWrite(void)
 		// Allow write on password match, or if the device is in unlocked mode
 		if (CryptoMem_VerifyShaPreimage(&gIoMem.regs.DATA[32u], &gNv.page1.NV_USER_AUTH[0u]))
 		{
+#if (CONFIG_CRYPTOMEM_NV_LOG_SLOTS != 0)
+			// Append to the NV log (records are sealed with a check value, torn records are skipped at startup)
+			if (!CryptoMem_NvLogAppend(&gIoMem.regs.DATA[0u]))
+			{
+				return 0xE4;
+			}
+#else
 			// Write to the flash
 			if (!Hal_NvWrite(&gNv.page1, &gIoMem.regs.DATA[0u]))
 			{
 				return 0xE4;
 			}
+#endif
 
 			// Reload the RAM mirror of the user data area
-			__builtin_memcpy(&gIoMem.regs.USER_DATA[0], &gNv.page1.NV_USER_DATA[0u], sizeof(gIoMem.regs.USER_DATA));
+			__builtin_memcpy(&gIoMem.regs.USER_DATA[0], &CRYPTOMEM_NV_USER_DATA[0u], sizeof(gIoMem.regs.USER_DATA));
+			CryptoMem_StateChanged();
 
 			// Maintenance operation is done
 			return 0x00u;
@@ -880,6 +2468,264 @@ static uint8_t CryptoMem_HandleSwitchToExtClock(void)
 #endif
 }
 
+//---------------------------------------------------------------------------------------------------------------------
+//
+// Command: 0xF3 - Crypto self-test and benchmark.
+//
+// This command repeatedly runs a known-answer test of the SHA-256 engine and reports the elapsed core clock cycles
+// (including the digest comparison of each iteration). The test aborts with a self-test failure if any iteration
+// produces an unexpected digest.
+//
+// Input:
+//     ARG_0: Primitive to be tested
+//              0x00 - SHA-256 ("abc" test vector from FIPS 180-2; 1 compression per iteration)
+//              0x01 - HMAC-SHA256 (test case 2 from RFC 4231; 4 compressions per iteration)
+//     ARG_1: Number of iterations (1-255)
+//
+// Output:
+//     RET_0: Return code from command
+//          0x00 - Success
+//          0xE1 - Parameter error
+//          0xE6 - Self-test failed
+//          0xEF - Command not supported in this build
+//
+//     RET_1: Reserved (set to zero)
+//
+//     DATA[3:0]: Elapsed core clock cycles (32-bit little-endian; modulo 2^24)
+//
+#if (CONFIG_CRYPTOMEM_BENCHMARK != 0)
+static const uint8_t kSelfTest_Sha256Digest[SHA256_HASH_LENGTH_BYTES] =
+{
+	0xBAu, 0x78u, 0x16u, 0xBFu, 0x8Fu, 0x01u, 0xCFu, 0xEAu, 0x41u, 0x41u, 0x40u, 0xDEu, 0x5Du, 0xAEu, 0x22u, 0x23u,
+	0xB0u, 0x03u, 0x61u, 0xA3u, 0x96u, 0x17u, 0x7Au, 0x9Cu, 0xB4u, 0x10u, 0xFFu, 0x61u, 0xF2u, 0x00u, 0x15u, 0xADu
+};
+
+static const uint8_t kSelfTest_HmacDigest[SHA256_HASH_LENGTH_BYTES] =
+{
+	0x5Bu, 0xDCu, 0xC1u, 0x46u, 0xBFu, 0x60u, 0x75u, 0x4Eu, 0x6Au, 0x04u, 0x24u, 0x26u, 0x08u, 0x95u, 0x75u, 0xC7u,
+	0x5Au, 0x00u, 0x3Fu, 0x08u, 0x9Du, 0x27u, 0x39u, 0x83u, 0x9Du, 0xECu, 0x58u, 0xB9u, 0x64u, 0xECu, 0x38u, 0x43u
+};
+#endif
+
+static uint8_t CryptoMem_HandleSelfTest(void)
+{
+#if (CONFIG_CRYPTOMEM_BENCHMARK != 0)
+	const uint8_t mode = gIoMem.regs.ARG_0;
+	const uint8_t iterations = gIoMem.regs.ARG_1;
+
+	if (mode > 0x01u || iterations == 0u)
+	{
+		// Parameter error
+		return 0xE1u;
+	}
+
+	const uint8_t *const expected = (mode == 0x00u) ? &kSelfTest_Sha256Digest[0u] : &kSelfTest_HmacDigest[0u];
+	uint8_t digest[SHA256_HASH_LENGTH_BYTES];
+	bool passed = true;
+
+	const uint32_t start = Hal_ReadCycleCounter();
+
+	for (uint32_t i = 0u; i < iterations; ++i)
+	{
+		if (mode == 0x00u)
+		{
+			// SHA-256("abc")
+			Sha256_Init();
+			Sha256_Update("abc", 3u);
+			Sha256_Final(&digest[0u]);
+		}
+		else
+		{
+			// HMAC-SHA256("Jefe", "what do ya want for nothing?")
+			Sha256_HmacInit((const uint8_t *) "Jefe", 4u);
+			Sha256_HmacUpdate("what do ya want for nothing?", 28u);
+			Sha256_HmacFinal(&digest[0u]);
+		}
+
+		passed = passed && (0 == __builtin_memcmp(&digest[0u], expected, SHA256_HASH_LENGTH_BYTES));
+	}
+
+	const uint32_t cycles = (Hal_ReadCycleCounter() - start) & HAL_CYCLE_COUNTER_MASK;
+
+	if (!passed)
+	{
+		// Self-test failed
+		return 0xE6u;
+	}
+
+	// Return the elapsed cycles
+	__UNALIGNED_UINT32_WRITE(&gIoMem.regs.DATA[0u], cycles);
+	CryptoMem_SetResponseLength(sizeof(uint32_t));
+	return 0x00u;
+#else
+	// Not supported in this build
+	return 0xEFu;
+#endif
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+static uint8_t CryptoMem_DispatchCommand(const uint8_t cmd);
+
+//---------------------------------------------------------------------------------------------------------------------
+//
+// Command: 0xD0 - Batch execution
+//
+// This command executes a list of sub-commands back to back. Each sub-command is executed by its regular command
+// handler, with the same inputs (ARG_0, ARG_1 and DATA) as if it had been issued on its own.
+//
+// Input:
+//     ARG_0: Length of the sub-command list in the DATA area (1-80 bytes)
+//     ARG_1: Reserved (ignored; should be zero)
+//
+//     DATA: Sub-command list. Each entry consists of a 4-byte header, followed by the input data of the sub-command:
+//        +0 Command code (CMD) of the sub-command
+//        +1 ARG_0 of the sub-command
+//        +2 ARG_1 of the sub-command
+//        +3 Length of the input data (copied to the start of the DATA area before the sub-command is executed)
+//
+// Output:
+//     RET_0: Return code from command
+//          0x00 - All sub-commands completed successfully
+//          0xE1 - Parameter error (malformed sub-command list; no sub-command was executed)
+//          0xEF - Command not supported in this build
+//          (any other value is the return code of the failed sub-command)
+//
+//     RET_1: Number of executed sub-commands (including a failed sub-command)
+//
+//     DATA: Response data of the last executed sub-command
+//
+// Execution stops after the first sub-command that fails, or that returns response data. NV write (0xF1) and batch
+// commands cannot be part of a batch.
+//
+static uint8_t CryptoMem_HandleBatch(void)
+{
+#if (CONFIG_CRYPTOMEM_BATCH != 0)
+	const uint32_t list_len = gIoMem.regs.ARG_0;
+
+	if ((list_len == 0u) || (list_len > sizeof(gIoMem.regs.DATA)))
+	{
+		// Parameter error
+		return 0xE1u;
+	}
+
+	// Validate the sub-command list (before executing anything)
+	uint32_t pos = 0u;
+	while (pos < list_len)
+	{
+		const uint8_t cmd = gIoMem.regs.DATA[pos];
+
+		if ((list_len - pos < 4u) || (cmd == 0xD0u) || (cmd == 0xF1u))
+		{
+			// Parameter error (truncated header or sub-command not allowed)
+			return 0xE1u;
+		}
+
+		pos += 4u + gIoMem.regs.DATA[pos + 3u];
+	}
+
+	if (pos != list_len)
+	{
+		// Parameter error (truncated input data)
+		return 0xE1u;
+	}
+
+	// Execute the sub-commands
+	uint8_t status = 0x00u;
+	uint8_t count = 0u;
+
+	pos = 0u;
+	while ((pos < list_len) && (status == 0x00u) && (gResponseLength == 0u))
+	{
+		const uint8_t cmd      = gIoMem.regs.DATA[pos + 0u];
+		const uint8_t arg_0    = gIoMem.regs.DATA[pos + 1u];
+		const uint8_t arg_1    = gIoMem.regs.DATA[pos + 2u];
+		const uint8_t data_len = gIoMem.regs.DATA[pos + 3u];
+
+		// Move the input data to the start of the DATA area (the remaining entries are located behind it)
+		__builtin_memmove(&gIoMem.regs.DATA[0u], &gIoMem.regs.DATA[pos + 4u], data_len);
+		pos += 4u + data_len;
+
+		gIoMem.regs.ARG_0 = arg_0;
+		gIoMem.regs.ARG_1 = arg_1;
+
+		status = CryptoMem_DispatchCommand(cmd);
+		++count;
+	}
+
+	gIoMem.regs.RET_1 = count;
+	return status;
+#else
+	// Not supported in this build
+	return 0xEFu;
+#endif
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+//
+// Command: 0xF4 - Read command telemetry
+//
+// Input:
+//     ARG_0: Command code to be queried (commands without an individual record share one record)
+//     ARG_1: Options
+//        [7:1] Reserved (ignored; should be zero)
+//        [0]   Clear the telemetry record after reading
+//
+// Output:
+//     RET_0: Return code from command
+//          0x00 - Success
+//          0xEF - Command not supported in this build
+//
+//     RET_1: Reserved (set to zero)
+//
+//     DATA[ 31:  0]: Number of executions (modulo 2^16)
+//     DATA[ 63: 32]: Number of executions with a non-zero return code (modulo 2^16)
+//     DATA[ 95: 64]: Execution time of the last execution (core clock cycles)
+//     DATA[127: 96]: Maximum execution time (core clock cycles)
+//     DATA[159:128]: Accumulated time spent in the wired interface ISR during executions (core clock cycles)
+//     DATA[191:160]: Total time spent in the wired interface ISR since startup (core clock cycles; modulo 2^32)
+//
+// All values are 32-bit little-endian integers.
+//
+#if (CONFIG_CRYPTOMEM_TELEMETRY != 0)
+static CryptoMem_Telemetry_t* CryptoMem_GetTelemetry(const uint8_t cmd)
+{
+	uint32_t i = 0u;
+
+	while ((i < sizeof(kTelemetryCommands)) && (kTelemetryCommands[i] != cmd))
+	{
+		++i;
+	}
+
+	return &gTelemetry[i];
+}
+#endif
+
+static uint8_t CryptoMem_HandleReadTelemetry(void)
+{
+#if (CONFIG_CRYPTOMEM_TELEMETRY != 0)
+	CryptoMem_Telemetry_t *const record = CryptoMem_GetTelemetry(gIoMem.regs.ARG_0);
+
+	__UNALIGNED_UINT32_WRITE(&gIoMem.regs.DATA[ 0u], record->count);
+	__UNALIGNED_UINT32_WRITE(&gIoMem.regs.DATA[ 4u], record->errors);
+	__UNALIGNED_UINT32_WRITE(&gIoMem.regs.DATA[ 8u], record->last_cycles);
+	__UNALIGNED_UINT32_WRITE(&gIoMem.regs.DATA[12u], record->max_cycles);
+	__UNALIGNED_UINT32_WRITE(&gIoMem.regs.DATA[16u], record->isr_cycles);
+	__UNALIGNED_UINT32_WRITE(&gIoMem.regs.DATA[20u], Hal_GetIsrCycles());
+
+	if ((gIoMem.regs.ARG_1 & 0x01u) != 0u)
+	{
+		// Clear on read
+		__builtin_memset(record, 0u, sizeof(*record));
+	}
+
+	CryptoMem_SetResponseLength(6u * sizeof(uint32_t));
+	return 0x00u;
+#else
+	// Not supported in this build
+	return 0xEFu;
+#endif
+}
+
 //---------------------------------------------------------------------------------------------------------------------
 static uint8_t CryptoMem_HandleNop(void)
 {
@@ -887,7 +2733,7 @@ static uint8_t CryptoMem_HandleNop(void)
 }
 
 //---------------------------------------------------------------------------------------------------------------------
-void CryptoMem_HandleCommand(void)
+static uint8_t CryptoMem_DispatchCommand(const uint8_t cmd)
 {
 	uint8_t status;
 
@@ -895,28 +2741,60 @@ void CryptoMem_HandleCommand(void)
 	CryptoMem_SetResponseLength(0u);
 
 	// Dispatch the command
-	switch (gIoMem.regs.CMD)
+	switch (cmd)
 	{
 	case 0x00u: // No operation
 		status = CryptoMem_HandleNop();
 		break;
 
 	case 0xA0u: // Quote
-		status = CryptoMem_HandleQuote();
+		status = CryptoMem_HandleQuote(0u);
+		break;
+
+	case 0xA1u: // Quote including the NV counters
+		status = CryptoMem_HandleQuoteNvCounters();
 		break;
 
 	case 0xB0u:  // HMAC Key Derivarion
 		status = CryptoMem_HandleHmacKeyDerivation();
 		break;
 
+	case 0xB1u: // Batch HMAC key derivation
+		status = CryptoMem_HandleBatchHmacKeyDerivation();
+		break;
+
 	case 0xE0u: // Extend PCR
 		status = CryptoMem_HandleExtend();
 		break;
 
+	case 0xE1u: // Read composite PCR digest
+		status = CryptoMem_HandleReadCompositePcr();
+		break;
+
+	case 0xE4u: // Begin hash session
+		status = CryptoMem_HandleSessionBegin();
+		break;
+
+	case 0xE5u: // Update hash session
+		status = CryptoMem_HandleSessionUpdate();
+		break;
+
+	case 0xE6u: // Finish hash session
+		status = CryptoMem_HandleSessionFinish();
+		break;
+
+	case 0xD0u: // Batch execution
+		status = CryptoMem_HandleBatch();
+		break;
+
 	case 0xC0: // Increment counter
 		status = CryptoMem_HandleIncrement();
 		break;
 
+	case 0xC1: // Read/increment NV counter
+		status = CryptoMem_HandleNvCounter();
+		break;
+
 	case 0xF1: // Write our NV flash configuration
 		status = CryptoMem_HandleNvWrite();
 		break;
@@ -925,12 +2803,54 @@ void CryptoMem_HandleCommand(void)
 		status = CryptoMem_HandleSwitchToExtClock();
 		break;
 
+	case 0xF3: // Crypto self-test and benchmark
+		status = CryptoMem_HandleSelfTest();
+		break;
+
+	case 0xF4: // Read command telemetry
+		status = CryptoMem_HandleReadTelemetry();
+		break;
+
 	default:
 		// Unknown command
 		status = 0xE2u;
 		break;
 	}
 
+	return status;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void CryptoMem_HandleCommand(void)
+{
+#if (CONFIG_CRYPTOMEM_CLOCK_SCALING != 0)
+	// Run the command at the fast clock
+	Hal_SetFastClock(true);
+#endif
+
+#if (CONFIG_CRYPTOMEM_TELEMETRY != 0)
+	const uint8_t cmd = gIoMem.regs.CMD;
+	const uint32_t start = Hal_ReadCycleCounter();
+	const uint32_t isr_start = Hal_GetIsrCycles();
+#endif
+
+	// Execute the command
+	const uint8_t status = CryptoMem_DispatchCommand(gIoMem.regs.CMD);
+
+#if (CONFIG_CRYPTOMEM_TELEMETRY != 0)
+	// Update the telemetry record of the command
+	{
+		CryptoMem_Telemetry_t *const record = CryptoMem_GetTelemetry(cmd);
+		const uint32_t cycles = (Hal_ReadCycleCounter() - start) & HAL_CYCLE_COUNTER_MASK;
+
+		record->count++;
+		record->errors += (status != 0x00u) ? 1u : 0u;
+		record->last_cycles = cycles;
+		record->max_cycles = (cycles > record->max_cycles) ? cycles : record->max_cycles;
+		record->isr_cycles += Hal_GetIsrCycles() - isr_start;
+	}
+#endif
+
 	// Complete the command and setup the respone transfer
 	CryptoMem_CompleteCommandWithData(status);
 }
@@ -945,6 +2865,11 @@ int main(void)
 	CryptoMem_Init();
 
 #if (CONFIG_WIRED_IF_TYPE == CONFIG_WIRED_IF_I2C)
+#if (CONFIG_CRYPTOMEM_IAP_BUS_SERVICE != 0)
+  	// Serve the I/O memory (with a busy command window) while the flash is busy
+  	Eep_I2CSetBusyImage(&gIoMem.raw[0u], IOMEM_REG_OFF(VOLATILE_BITS));
+#endif
+
 	// Finally start the I2C slave (after this point commands can be received at any time)
   	Eep_I2CStartSlave(gNv.page0.NV_SYS_CFG.bits.I2C_ADDR);
 
@@ -63,6 +63,18 @@ typedef struct Eep_Slave
  */
 static Eep_Slave_t gSlave;
 
+#if (CONFIG_CRYPTOMEM_IAP_BUS_SERVICE != 0)
+/**
+ * @brief Register image that is served while the flash is busy
+ */
+static const uint8_t *gBusyImage;
+
+/**
+ * @brief First register address that is read from the busy image (lower addresses read as 0xFF)
+ */
+static uint8_t gBusyLimit;
+#endif
+
 #define I2C_SLAVE_DEV       I2C0
 #define I2C_SLAVE_IRQ_FLAGS (I2C_INTSTAT_SLVPENDING_MASK | I2C_INTSTAT_SLVDESEL_MASK)
 #define I2C_SLAVE_NVIC_IRQn I2C0_IRQn
@@ -74,18 +86,19 @@ static Eep_Slave_t gSlave;
 
 
 //---------------------------------------------------------------------------------------------------------------------
-void Eep_I2CSetClockDivider(void)
+void Eep_I2CSetClockDivider(const bool fast)
 {
 	// Setup the I2C clock divider for standard speed (100 kHz)
 	//
 	// Calculation ported from MCUxpresso fsl_i2c driver (I2C_SlaveDivVal)
 	//
-	// NOTE: We assume a fixed system clock (DEFAULT_SYSTEM_CLOCK). This allows constant folding on the divider
-	// calculation (and omits the __aeabi_udiv division code).
+	// NOTE: We assume fixed system clocks (HAL_SYSTEM_CLOCK, or HAL_SYSTEM_CLOCK_FAST during command execution). This
+	// allows constant folding on the divider calculation (and omits the __aeabi_udiv division code).
 
 	/* divVal = (sourceClock_Hz / 1000000) * (dataSetupTime_ns / 1000) */
-	const uint32_t data_setup_ns = 250u;
-	const uint32_t divider = ((HAL_SYSTEM_CLOCK / 1000u) * data_setup_ns) / 1000000u;
+#define EEP_I2C_SLAVE_DIVVAL(clock_hz) ((((clock_hz) / 1000u) * 250u) / 1000000u)
+	const uint32_t divider = fast ? EEP_I2C_SLAVE_DIVVAL(HAL_SYSTEM_CLOCK_FAST) : EEP_I2C_SLAVE_DIVVAL(HAL_SYSTEM_CLOCK);
+#undef EEP_I2C_SLAVE_DIVVAL
 	I2C_SLAVE_DEV->CLKDIV = (divider < I2C_CLKDIV_DIVVAL_MASK) ? divider : I2C_CLKDIV_DIVVAL_MASK;
 }
 
@@ -186,7 +199,12 @@ void Eep_I2CSlaveIrqHandler(void)
 		else if (slvstate == I2C_STAT_SLVST_TX)
 		{
 			// Slave Transmit (data can be transmitted)
+#if (CONFIG_CRYPTOMEM_REGISTER_MAP_V2 != 0)
+			const uint8_t tx_addr = gSlave.reg_addr;
+			gSlave.reg_addr = Eep_NextReadAddressCallback(tx_addr);
+#else
 			const uint8_t tx_addr = gSlave.reg_addr++;
+#endif
 
 			// Respond with one byte of data from the current address
 			I2C_SLAVE_DEV->SLVDAT = Eep_ByteReadCallback(tx_addr);
@@ -205,4 +223,67 @@ void Eep_I2CSlaveIrqHandler(void)
 	}
 }
 
+#if (CONFIG_CRYPTOMEM_IAP_BUS_SERVICE != 0)
+//---------------------------------------------------------------------------------------------------------------------
+void Eep_I2CSetBusyImage(const uint8_t *const image, const uint8_t busy_limit)
+{
+	gBusyImage = image;
+	gBusyLimit = busy_limit;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+RAMFUNCTION_SECTION_CODE(void Eep_I2CSlaveBusyIrqHandler(void))
+{
+	// NOTE: This handler runs while the flash is busy. It must not call (or read constants from) flash.
+	const uint32_t stat = I2C_SLAVE_DEV->STAT;
+
+	if ((stat & I2C_STAT_SLVDESEL_MASK) != 0U)
+	{
+		// Slave de-select event
+		gSlave.state = kEep_SlaveReady;
+
+		// Clear the slave de-select status bit
+		I2C_SLAVE_DEV->STAT = I2C_STAT_SLVDESEL_MASK;
+	}
+
+	if ((stat & I2C_STAT_SLVPENDING_MASK) != 0)
+	{
+		const uint32_t slvstate = (stat & I2C_STAT_SLVSTATE_MASK) >> I2C_STAT_SLVSTATE_SHIFT;
+
+		if (slvstate == I2C_STAT_SLVST_RX)
+		{
+			const uint8_t rx_data = I2C_SLAVE_DEV->SLVDAT;
+
+			if (gSlave.state == kEep_SlaveAddress)
+			{
+				// Accept the sub-address (a repeated start for a read may follow)
+				gSlave.reg_addr = rx_data;
+				gSlave.state = kEep_SlaveDataWrite;
+			}
+			else
+			{
+				// Data writes cannot be processed while the flash is busy
+				I2C_SLAVE_DEV->SLVCTL = I2C_SLVCTL_SLVNACK_MASK;
+				return;
+			}
+		}
+		else if (slvstate == I2C_STAT_SLVST_TX)
+		{
+			// Respond with busy for the command window, and from the register image otherwise
+			const uint8_t tx_addr = gSlave.reg_addr++;
+
+			I2C_SLAVE_DEV->SLVDAT = (tx_addr < gBusyLimit) ? UINT8_C(0xFF) : gBusyImage[tx_addr];
+		}
+		else
+		{
+			// Slave address matched (or reserved state; the flash-based halt handler is unavailable here)
+			gSlave.state = kEep_SlaveAddress;
+		}
+
+		// Continue the I2C transaction
+		I2C_SLAVE_DEV->SLVCTL = I2C_SLVCTL_SLVCONTINUE_MASK;
+	}
+}
+#endif
+
 #endif //  (CONFIG_WIRED_IF_TYPE == CONFIG_WIRED_IF_I2C)
@@ -19,7 +19,7 @@
  *   slave is enabled for the first time. It is kept separately from the slave startup as
  *   provision for simple integration in dual-role master/slave devices.
  */
-extern void Eep_I2CSetClockDivider(void);
+extern void Eep_I2CSetClockDivider(const bool fast);
 
 /**
  * @brief Starts the I2C slave interface.
@@ -35,6 +35,21 @@ extern void Eep_I2CStopSlave(void);
  * @brief IRQ handler for slave interrupts.
  */
 extern void Eep_I2CSlaveIrqHandler(void);
+
+#if (CONFIG_CRYPTOMEM_IAP_BUS_SERVICE != 0)
+/**
+ * @brief Sets the register image that is served while the flash is busy.
+ *
+ * @param[in] image points to the 256-byte register image (in SRAM).
+ * @param[in] busy_limit is the first register address that is read from the image (lower addresses read as 0xFF).
+ */
+extern void Eep_I2CSetBusyImage(const uint8_t *const image, const uint8_t busy_limit);
+
+/**
+ * @brief SRAM-resident IRQ handler for slave interrupts while the flash is busy.
+ */
+extern void Eep_I2CSlaveBusyIrqHandler(void);
+#endif
 #endif
 
 #if (CONFIG_WIRED_IF_TYPE == CONFIG_WIRED_IF_UART)
@@ -64,4 +79,11 @@ extern uint8_t Eep_ByteReadCallback(uint8_t address);
  */
 extern void Eep_ByteWriteCallback(uint8_t address, uint8_t data);
 
+#if (CONFIG_CRYPTOMEM_REGISTER_MAP_V2 != 0)
+/**
+ * @brief Provides the address of the next byte of a sequential read.
+ */
+extern uint8_t Eep_NextReadAddressCallback(uint8_t address);
+#endif
+
 #endif /* EEP_H_ */
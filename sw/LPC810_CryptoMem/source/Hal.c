@@ -4,6 +4,7 @@
  */
 
 #include <Hal.h>
+#include <HalNv.h>
 #include <Eep.h>
 
 #include "board.h"
@@ -42,7 +43,7 @@ HAL_INIT_CODE void Hal_Init(void)
 
 	// Setup the I2C slave
 	CLOCK_EnableClock(kCLOCK_I2c0);
-	Eep_I2CSetClockDivider();
+	Eep_I2CSetClockDivider(false);
 
 #elif (CONFIG_WIRED_IF_TYPE == CONFIG_WIRED_IF_UART)
 	BOARD_UARTInitPins();
@@ -54,6 +55,63 @@ HAL_INIT_CODE void Hal_Init(void)
 #endif
 }
 
+#if (CONFIG_CRYPTOMEM_CLOCK_SCALING != 0)
+_Static_assert(HAL_SYSTEM_CLOCK_FAST / HAL_SYSTEM_CLOCK_DIV == HAL_SYSTEM_CLOCK,
+	"The default system clock must be the PLL output divided by HAL_SYSTEM_CLOCK_DIV.");
+
+//---------------------------------------------------------------------------------------------------------------------
+/**
+ * @brief Clock scaling is possible (main clock is the PLL output)
+ */
+static bool gHal_ClockScaling = true;
+
+/**
+ * @brief The core currently runs at the fast clock
+ */
+static bool gHal_FastClock = false;
+
+//---------------------------------------------------------------------------------------------------------------------
+void Hal_SetFastClock(bool fast)
+{
+	if (!gHal_ClockScaling || (fast == gHal_FastClock))
+	{
+		// Running on the external clock (no scaling), or already at the requested clock
+		return;
+	}
+
+	const uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	if (fast)
+	{
+		// Two system clocks flash access time (required above 20 MHz) before the core clock goes up
+		FLASH_CTRL->FLASHCFG = (FLASH_CTRL->FLASHCFG & ~FLASH_CTRL_FLASHCFG_FLASHTIM_MASK) | FLASH_CTRL_FLASHCFG_FLASHTIM(1u);
+
+		// Main clock (PLL output) undivided
+		CLOCK_SetCoreSysClkDiv(1u);
+		SystemCoreClock = HAL_SYSTEM_CLOCK_FAST;
+	}
+	else
+	{
+		// Back to the default clock
+		CLOCK_SetCoreSysClkDiv(HAL_SYSTEM_CLOCK_DIV);
+		SystemCoreClock = HAL_SYSTEM_CLOCK_FAST / HAL_SYSTEM_CLOCK_DIV;
+
+		// One system clock flash access time (once the core clock is down)
+		FLASH_CTRL->FLASHCFG = (FLASH_CTRL->FLASHCFG & ~FLASH_CTRL_FLASHCFG_FLASHTIM_MASK) | FLASH_CTRL_FLASHCFG_FLASHTIM(0u);
+	}
+
+	gHal_FastClock = fast;
+
+# if (CONFIG_WIRED_IF_TYPE == CONFIG_WIRED_IF_I2C)
+	// The I2C slave is clocked from the system clock
+	Eep_I2CSetClockDivider(fast);
+# endif
+
+	__set_PRIMASK(primask);
+}
+#endif
+
 //---------------------------------------------------------------------------------------------------------------------
 #if (CONFIG_WIRED_IF_TYPE == CONFIG_WIRED_IF_I2C)
 //
@@ -63,6 +121,13 @@ void Hal_SwitchToExtClock(void)
 {
 	__disable_irq();
 
+#if (CONFIG_CRYPTOMEM_CLOCK_SCALING != 0)
+	// The external clock is used as-is (no clock scaling)
+	gHal_ClockScaling = false;
+	SystemCoreClock = HAL_SYSTEM_CLOCK;
+	Eep_I2CSetClockDivider(false);
+#endif
+
 	// First switch to 12 MHz IRC clock
 	CLOCK_SetMainClkSrc(kCLOCK_MainClkSrcIrc);
 	CLOCK_SetCoreSysClkDiv(1u);
@@ -123,6 +188,37 @@ __NO_RETURN void Hal_Halt(void)
 	}
 }
 
+//---------------------------------------------------------------------------------------------------------------------
+void Hal_StartCycleCounter(void)
+{
+	// Free-running SysTick down-counter on the core clock (no interrupt; the SysTick handler halts the device)
+	SysTick->CTRL = 0u;
+	SysTick->LOAD = HAL_CYCLE_COUNTER_MASK;
+	SysTick->VAL  = 0u;
+	SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_ENABLE_Msk;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+uint32_t Hal_ReadCycleCounter(void)
+{
+	// Elapsed core clock cycles since the last call to Hal_StartCycleCounter (modulo 2^24)
+	return (HAL_CYCLE_COUNTER_MASK - SysTick->VAL) & HAL_CYCLE_COUNTER_MASK;
+}
+
+#if (CONFIG_CRYPTOMEM_TELEMETRY != 0)
+//---------------------------------------------------------------------------------------------------------------------
+/**
+ * @brief Core clock cycles spent in the wired interface ISR (since startup)
+ */
+static volatile uint32_t gHal_IsrCycles;
+
+//---------------------------------------------------------------------------------------------------------------------
+uint32_t Hal_GetIsrCycles(void)
+{
+	return gHal_IsrCycles;
+}
+#endif
+
 //---------------------------------------------------------------------------------------------------------------------
 void Hal_ReadDeviceID(uint32_t device_id[4u])
 {
@@ -172,8 +268,96 @@ __NO_RETURN void Hal_EnterBootloader(void)
 	__builtin_unreachable();
 }
 
+// System clock passed to the IAP flash routines (the core clock changes at runtime in clock scaling builds)
+#if (CONFIG_CRYPTOMEM_CLOCK_SCALING != 0)
+# define HAL_IAP_CLOCK SystemCoreClock
+#else
+# define HAL_IAP_CLOCK HAL_SYSTEM_CLOCK
+#endif
+
+#if (CONFIG_CRYPTOMEM_IAP_BUS_SERVICE != 0)
 //---------------------------------------------------------------------------------------------------------------------
-bool Hal_NvWrite(const void* data, const uint8_t nv_page[64u])
+// SRAM address range (1 KiB on the LPC810)
+#define HAL_SRAM_START UINT32_C(0x10000000)
+#define HAL_SRAM_END   UINT32_C(0x10000400)
+
+/**
+ * @brief SRAM vector table used during IAP flash operations (up to and including the I2C0 vector)
+ *
+ * The table is 100 bytes, and VTOR needs a 128-byte aligned table (up to 124 bytes of padding in front of it).
+ */
+static uint32_t gHal_IapVectors[16u + I2C0_IRQn + 1u] __attribute__((__aligned__(128u)));
+
+/**
+ * @brief Regular (flash) vector table address
+ */
+static uint32_t gHal_FlashVtor;
+
+//---------------------------------------------------------------------------------------------------------------------
+static uint32_t Hal_IapBegin(void)
+{
+	// Serve the I2C slave from SRAM while the flash is busy (all other interrupts are masked)
+	const uint32_t *const flash_vectors = (const uint32_t *) SCB->VTOR;
+	const uint32_t busy_handler = (uint32_t) &Eep_I2CSlaveBusyIrqHandler;
+
+	gHal_FlashVtor = (uint32_t) flash_vectors;
+
+	if ((busy_handler < HAL_SRAM_START) || (busy_handler >= HAL_SRAM_END))
+	{
+		// The handler was not placed in SRAM (RamFunction section; see the linker settings). Keep the flash vector
+		// table (the I2C slave stalls until the flash operation is done; Hal_IapEnd restores the same state).
+		return NVIC->ISER[0u];
+	}
+
+	for (uint32_t i = 0u; i < (sizeof(gHal_IapVectors) / sizeof(gHal_IapVectors[0u])); ++i)
+	{
+		gHal_IapVectors[i] = flash_vectors[i];
+	}
+
+	gHal_IapVectors[16u + I2C0_IRQn] = busy_handler;
+
+	const uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	const uint32_t enabled_irqs = NVIC->ISER[0u];
+	NVIC->ICER[0u] = enabled_irqs & ~(UINT32_C(1) << I2C0_IRQn);
+
+	SCB->VTOR = (uint32_t) &gHal_IapVectors[0u];
+	__DSB();
+
+	__set_PRIMASK(primask);
+	return enabled_irqs;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+static void Hal_IapEnd(const uint32_t enabled_irqs)
+{
+	// Back to the flash vector table (and the regular interrupt handlers)
+	const uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	SCB->VTOR = gHal_FlashVtor;
+	NVIC->ISER[0u] = enabled_irqs;
+	__DSB();
+
+	__set_PRIMASK(primask);
+}
+#else
+//---------------------------------------------------------------------------------------------------------------------
+static inline uint32_t Hal_IapBegin(void)
+{
+	return 0u;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+static inline void Hal_IapEnd(const uint32_t enabled_irqs)
+{
+	(void) enabled_irqs;
+}
+#endif
+
+//---------------------------------------------------------------------------------------------------------------------
+bool Hal_NvErase(const void* data)
 {
 	// Prepare+Erase
 	const uint32_t addr = (uint32_t) data;
@@ -185,13 +369,26 @@ bool Hal_NvWrite(const void* data, const uint8_t nv_page[64u])
 		return false;
 	}
 
-	if (kStatus_IAP_Success != IAP_ErasePage(page, page, HAL_SYSTEM_CLOCK))
+	const uint32_t irq_state = Hal_IapBegin();
+	const status_t status = IAP_ErasePage(page, page, HAL_IAP_CLOCK);
+	Hal_IapEnd(irq_state);
+
+	if (kStatus_IAP_Success != status)
 	{
 		// Erase failed
 		return false;
 	}
 
-	// Prepare+Write
+	return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool Hal_NvProgram(const void* data, const uint8_t nv_page[64u])
+{
+	// Prepare+Write (programming can only clear bits; see Hal_NvWrite for pages that need an erase)
+	const uint32_t addr = (uint32_t) data;
+	const uint32_t page =  (addr - HAL_NV_FLASH_START) / HAL_NV_PAGE_SIZE;
+	const uint32_t sector = page / HAL_NV_PAGES_PER_SECTOR;
 	if (kStatus_IAP_Success != IAP_PrepareSectorForWrite(sector, sector))
 	{
 		// Prepare failed
@@ -199,7 +396,11 @@ bool Hal_NvWrite(const void* data, const uint8_t nv_page[64u])
 	}
 
 	// And write
-	if (kStatus_IAP_Success != IAP_CopyRamToFlash(addr, (uint32_t *) nv_page, HAL_NV_PAGE_SIZE, HAL_SYSTEM_CLOCK))
+	const uint32_t irq_state = Hal_IapBegin();
+	const status_t status = IAP_CopyRamToFlash(addr, (uint32_t *) nv_page, HAL_NV_PAGE_SIZE, HAL_IAP_CLOCK);
+	Hal_IapEnd(irq_state);
+
+	if (kStatus_IAP_Success != status)
 	{
 		// Write failed
 		return false;
@@ -208,6 +409,13 @@ bool Hal_NvWrite(const void* data, const uint8_t nv_page[64u])
 	return true;
 }
 
+//---------------------------------------------------------------------------------------------------------------------
+bool Hal_NvWrite(const void* data, const uint8_t nv_page[64u])
+{
+	// Skip unchanged pages, and erase only if bits need to be set
+	return Hal_NvUpdatePage(data, nv_page);
+}
+
 //---------------------------------------------------------------------------------------------------------------------
 void Hal_SetReadyPin(bool ready)
 {
@@ -222,8 +430,16 @@ void Hal_SetReadyPin(bool ready)
 void I2C0_IRQHandler(void)
 {
 #if (CONFIG_WIRED_IF_TYPE == CONFIG_WIRED_IF_I2C)
+# if (CONFIG_CRYPTOMEM_TELEMETRY != 0)
+	const uint32_t start = Hal_ReadCycleCounter();
+# endif
+
 	// I2C interface is used for virtual EEPROM interaction
 	Eep_I2CSlaveIrqHandler();
+
+# if (CONFIG_CRYPTOMEM_TELEMETRY != 0)
+	gHal_IsrCycles += (Hal_ReadCycleCounter() - start) & HAL_CYCLE_COUNTER_MASK;
+# endif
 #else
 	// I2C interface is not implemented
 	Hal_Halt();
@@ -233,8 +449,16 @@ void I2C0_IRQHandler(void)
 void USART0_IRQHandler(void)
 {
 #if (CONFIG_WIRED_IF_TYPE == CONFIG_WIRED_IF_UART)
+# if (CONFIG_CRYPTOMEM_TELEMETRY != 0)
+	const uint32_t start = Hal_ReadCycleCounter();
+# endif
+
 	// UART interface is used for virtual EEPROM interaction
 	Eep_UartIrqHandler();
+
+# if (CONFIG_CRYPTOMEM_TELEMETRY != 0)
+	gHal_IsrCycles += (Hal_ReadCycleCounter() - start) & HAL_CYCLE_COUNTER_MASK;
+# endif
 #else
 	// UART interface is not implemented
 #endif
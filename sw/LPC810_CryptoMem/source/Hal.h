@@ -10,11 +10,19 @@
 #include <stdbool.h>
 #include <stddef.h>
 
+#include <Config.h>
+
 // Pull-in the common device header
 #include "LPC810.h"
 
 // Default system clock (8 MHz)
-#define HAL_SYSTEM_CLOCK UINT32_C(0x8000000)
+#define HAL_SYSTEM_CLOCK UINT32_C(8000000)
+
+// Fast system clock during command execution (24 MHz PLL output; CONFIG_CRYPTOMEM_CLOCK_SCALING builds only)
+#define HAL_SYSTEM_CLOCK_FAST UINT32_C(24000000)
+
+// AHB clock divider of the default system clock (PLL output / 3; CONFIG_CRYPTOMEM_CLOCK_SCALING builds only)
+#define HAL_SYSTEM_CLOCK_DIV (3u)
 
 // Place a routine in the HAL initialization section
 //
@@ -27,11 +35,21 @@
 
 extern HAL_INIT_CODE void Hal_Init(void);
 extern void Hal_SwitchToExtClock(void);
+#if (CONFIG_CRYPTOMEM_CLOCK_SCALING != 0)
+extern void Hal_SetFastClock(bool fast);
+#endif
 extern void Hal_Idle(void);
 extern __NO_RETURN void Hal_Halt(void);
 
 extern void Hal_SetReadyPin(bool ready);
 
+// Range of the cycle counter (24-bit SysTick)
+#define HAL_CYCLE_COUNTER_MASK UINT32_C(0x00FFFFFF)
+
+extern void Hal_StartCycleCounter(void);
+extern uint32_t Hal_ReadCycleCounter(void);
+extern uint32_t Hal_GetIsrCycles(void);
+
 extern void Hal_ReadDeviceID(uint32_t device_id[4]);
 extern __NO_RETURN void Hal_EnterBootloader(void);
 
@@ -43,6 +61,8 @@ extern __NO_RETURN void Hal_EnterBootloader(void);
 #define HAL_NV_DATA \
 	__attribute__((__section__(".nv"), __used__, __aligned__((HAL_NV_PAGE_SIZE))))
 
+extern bool Hal_NvErase(const void* addr);
+extern bool Hal_NvProgram(const void* addr, const uint8_t nv_page[HAL_NV_PAGE_SIZE]);
 extern bool Hal_NvWrite(const void* addr, const uint8_t nv_page[HAL_NV_PAGE_SIZE]);
 
 #endif /* HAL_H_ */
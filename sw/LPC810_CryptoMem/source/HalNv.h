@@ -0,0 +1,47 @@
+/**
+ * @file
+ * @brief NV page update (shared by the target HAL and the host HAL)
+ */
+
+#ifndef HAL_NV_H_
+#define HAL_NV_H_
+
+#include <Hal.h>
+
+//---------------------------------------------------------------------------------------------------------------------
+/**
+ * @brief Writes a NV page with the fewest flash operations (implementation of @ref Hal_NvWrite).
+ *
+ * Unchanged pages are skipped, and pages that only need 1->0 transitions are programmed without an erase.
+ */
+static inline bool Hal_NvUpdatePage(const void* data, const uint8_t nv_page[HAL_NV_PAGE_SIZE])
+{
+	// Compare against the current flash contents
+	const uint32_t *const old_words = (const uint32_t *) data;
+	const uint32_t *const new_words = (const uint32_t *) nv_page;
+	uint32_t changed_bits = 0u;
+	uint32_t set_bits = 0u;
+
+	for (uint32_t i = 0u; i < HAL_NV_PAGE_SIZE / sizeof(uint32_t); ++i)
+	{
+		changed_bits |= old_words[i] ^ new_words[i];
+		set_bits     |= ~old_words[i] & new_words[i];
+	}
+
+	if (changed_bits == 0u)
+	{
+		// Page is unchanged (nothing to do)
+		return true;
+	}
+
+	if ((set_bits != 0u) && !Hal_NvErase(data))
+	{
+		// Erase failed (needed for 0->1 transitions)
+		return false;
+	}
+
+	// Program the page (without erase if only 1->0 transitions are needed)
+	return Hal_NvProgram(data, nv_page);
+}
+
+#endif /* HAL_NV_H_ */
@@ -4,39 +4,21 @@
  */
 #include "Sha256.h"
 
+#include <Config.h>
 #include <Hal.h>
 
 
 /**
- * @brief SHA-256 (and HMAC) calculation context
+ * @brief Global (singleton) instance of SHA (used by the context-less API)
  */
-typedef struct
-{
-	/**
-	 * @brief Hash state variables
-	 */
-	uint32_t H[8u];
-
-	/**
-	 * @brief Message word buffer (for circular word schedule)
-	 */
-	uint32_t W[16u];
-
-	/**
-	 * @brief Total length of the message in byte
-	 */
-	uint32_t msg_length;
-
-	/**
-	 * @brief Holding area for ipad/opad (in HMAC calculations)
-	 */
-	uint8_t pad[SHA256_HASH_BLOCK_LENGTH_BYTES];
-} Sha256_Ctx_t;
+static Sha256_Ctx_t gSha256;
 
+#if (CONFIG_SHA256_STATS != 0)
 /**
- * @brief Global (singleton) instance of SHA
+ * @brief Number of SHA-256 compression function invocations (since startup)
  */
-static Sha256_Ctx_t gSha256;
+static uint32_t gSha256_NumCompressions;
+#endif
 
 /**
  * @brief SHA-256 Initial Hash Values
@@ -70,6 +52,30 @@ static const uint32_t gkSha256_K[64u] =
 	   UINT32_C(0x90befffa), UINT32_C(0xa4506ceb), UINT32_C(0xbef9a3f7), UINT32_C(0xc67178f2)
 };
 
+/**
+ * @brief Precomputed sums K[i] + W[i] of the round constants and the message schedule for the constant final block
+ *   of a 64-byte message (0x80 padding byte, zero padding, 512-bit message length).
+ */
+static const uint32_t gkSha256_KW_Pad64[64u] =
+{
+	   UINT32_C(0xc28a2f98), UINT32_C(0x71374491), UINT32_C(0xb5c0fbcf), UINT32_C(0xe9b5dba5),
+	   UINT32_C(0x3956c25b), UINT32_C(0x59f111f1), UINT32_C(0x923f82a4), UINT32_C(0xab1c5ed5),
+	   UINT32_C(0xd807aa98), UINT32_C(0x12835b01), UINT32_C(0x243185be), UINT32_C(0x550c7dc3),
+	   UINT32_C(0x72be5d74), UINT32_C(0x80deb1fe), UINT32_C(0x9bdc06a7), UINT32_C(0xc19bf374),
+	   UINT32_C(0x649b69c1), UINT32_C(0xf0fe4786), UINT32_C(0x0fe1edc6), UINT32_C(0x240cf254),
+	   UINT32_C(0x4fe9346f), UINT32_C(0x6cc984be), UINT32_C(0x61b9411e), UINT32_C(0x16f988fa),
+	   UINT32_C(0xf2c65152), UINT32_C(0xa88e5a6d), UINT32_C(0xb019fc65), UINT32_C(0xb9d99ec7),
+	   UINT32_C(0x9a1231c3), UINT32_C(0xe70eeaa0), UINT32_C(0xfdb1232b), UINT32_C(0xc7353eb0),
+	   UINT32_C(0x3069bad5), UINT32_C(0xcb976d5f), UINT32_C(0x5a0f118f), UINT32_C(0xdc1eeefd),
+	   UINT32_C(0x0a35b689), UINT32_C(0xde0b7a04), UINT32_C(0x58f4ca9d), UINT32_C(0xe15d5b16),
+	   UINT32_C(0x007f3e86), UINT32_C(0x37088980), UINT32_C(0xa507ea32), UINT32_C(0x6fab9537),
+	   UINT32_C(0x17406110), UINT32_C(0x0d8cd6f1), UINT32_C(0xcdaa3b6d), UINT32_C(0xc0bbbe37),
+	   UINT32_C(0x83613bda), UINT32_C(0xdb48a363), UINT32_C(0x0b02e931), UINT32_C(0x6fd15ca7),
+	   UINT32_C(0x521afaca), UINT32_C(0x31338431), UINT32_C(0x6ed41a95), UINT32_C(0x6d437890),
+	   UINT32_C(0xc39c91f2), UINT32_C(0x9eccabbd), UINT32_C(0xb5c9a0e6), UINT32_C(0x532fb63c),
+	   UINT32_C(0xd2c741c6), UINT32_C(0x07237ea3), UINT32_C(0xa4954b68), UINT32_C(0x4c191d76)
+};
+
 //---------------------------------------------------------------------------------------------------------------------
 static inline uint32_t ROR(const uint32_t value, const uint32_t pos)
 {
@@ -82,14 +88,16 @@ static inline uint32_t SHR(const uint32_t value, const uint32_t pos)
 	return (value >> pos);
 }
 
+#if (CONFIG_SHA256_PROFILE == CONFIG_SHA256_PROFILE_SIZE)
 //---------------------------------------------------------------------------------------------------------------------
 /**
  * @brief Schedules the next message word of a given SHA context.
  *
  * @param[in] ctx is the SHA-256 hash context to be used.
+ * @param[in] block points to the (word-aligned) message block being processed.
  * @param[in] i is the current round number (in range 0..63)
  */
-static uint32_t Sha256_ScheduleNextWord(Sha256_Ctx_t *const ctx, const uint32_t i)
+static uint32_t Sha256_ScheduleNextWord(Sha256_Ctx_t *const ctx, const uint32_t block[16u], const uint32_t i)
 {
 	// The SHA-256 message word schedule  (for rounds >= 16) is typically written as:
 	//   s0 := ROR(w[i-15], 7)  ^ ROR(w[i-15], 18) ^ SHR(w[i-15], 3);
@@ -104,8 +112,8 @@ static uint32_t Sha256_ScheduleNextWord(Sha256_Ctx_t *const ctx, const uint32_t
 
 	if (i < 16u)
 	{
-		// Rounds 0 to 15. Directly load the word from the buffer (taking byte order adjustments into account)
-		W_i = __REV(ctx->W[i]);
+		// Rounds 0 to 15. Directly load the word from the message block (taking byte order adjustments into account)
+		W_i = __REV(block[i]);
 	}
 	else
 	{
@@ -126,11 +134,76 @@ static uint32_t Sha256_ScheduleNextWord(Sha256_Ctx_t *const ctx, const uint32_t
 	return W_i;
 }
 
+#elif (CONFIG_SHA256_PROFILE == CONFIG_SHA256_PROFILE_SPEED)
+//---------------------------------------------------------------------------------------------------------------------
+static inline uint32_t Sha256_BigSigma0(const uint32_t x)
+{
+	return ROR(x, 2u) ^ ROR(x, 13u) ^ ROR(x, 22u);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+static inline uint32_t Sha256_BigSigma1(const uint32_t x)
+{
+	return ROR(x, 6u) ^ ROR(x, 11u) ^ ROR(x, 25u);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+static inline uint32_t Sha256_SmallSigma0(const uint32_t x)
+{
+	return ROR(x, 7u) ^ ROR(x, 18u) ^ SHR(x, 3u);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+static inline uint32_t Sha256_SmallSigma1(const uint32_t x)
+{
+	return ROR(x, 17u) ^ ROR(x, 19u) ^ SHR(x, 10u);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+/**
+ * @brief Evaluates round (r + j) of the compression function (speed profile).
+ *
+ * The working variables are not shuffled after each round. Instead the roles of a..h are rotated by passing the
+ * variables in rotated order (round j uses rotation j % 8); only d and h (in the role names of the round) change.
+ *
+ * The message word is scheduled in-place in the circular W[0..15] buffer (rounds >= 16 only). The index j is a
+ * compile-time constant in the unrolled loop body, which allows the compiler to fold all buffer indices.
+ *
+ * @remarks Expects the round group offset r, the round constant pointer K (&gkSha256_K[r]) and the word buffer W
+ *   in the enclosing scope.
+ */
+#define SHA256_ROUND(a, b, c, d, e, f, g, h, j) \
+	do \
+	{ \
+		uint32_t W_j = W[(j)]; \
+		if (r != 0u) \
+		{ \
+			W_j += Sha256_SmallSigma1(W[((j) + 14u) % 16u]) + W[((j) + 9u) % 16u] + \
+				Sha256_SmallSigma0(W[((j) + 1u) % 16u]); \
+			W[(j)] = W_j; \
+		} \
+		\
+		(h) += Sha256_BigSigma1(e) + (((e) & (f)) ^ (~(e) & (g))) + K[(j)] + W_j; \
+		(d) += (h); \
+		(h) += Sha256_BigSigma0(a) + (((a) & (b)) ^ ((a) & (c)) ^ ((b) & (c))); \
+	} while (0)
+
+#else
+# error "Unsupported SHA-256 profile configuration"
+#endif
+
 //---------------------------------------------------------------------------------------------------------------------
 /**
- * @brief Processes the current message block of the given SHA context.
+ * @brief Processes a message block with the given SHA context.
+ *
+ * @param[in] ctx is the SHA-256 hash context to be used.
+ * @param[in] block points to the (word-aligned) message block to be processed. The block can either be
+ *   the word buffer of the context itself, or any other word-aligned 64-byte message block.
+ *
+ * @remarks The message words are loaded (and byte-swapped) directly from the message block. The word buffer
+ *   of the context is used for the circular word schedule and is therefore clobbered by this function.
  */
-static void Sha256_Process(Sha256_Ctx_t *const ctx)
+static void Sha256_ProcessBlock(Sha256_Ctx_t *const ctx, const uint32_t block[16u])
 {
 	// Load the working variables from the current hash state
 	uint32_t a = ctx->H[0u];
@@ -142,11 +215,12 @@ static void Sha256_Process(Sha256_Ctx_t *const ctx)
 	uint32_t g = ctx->H[6u];
 	uint32_t h = ctx->H[7u];
 
+#if (CONFIG_SHA256_PROFILE == CONFIG_SHA256_PROFILE_SIZE)
 	// Iterate the round functions
 	for (uint32_t i = 0u; i <= 63u; ++i)
 	{
 		// Step 1: Schedule the next message word
-		const uint32_t W_i   = Sha256_ScheduleNextWord(ctx, i);
+		const uint32_t W_i   = Sha256_ScheduleNextWord(ctx, block, i);
 
 		// Step 2: Evaluate the round function
 		const uint32_t S0    = ROR(a, 2u) ^ ROR(a, 13u) ^ ROR(a, 22u);
@@ -166,6 +240,39 @@ static void Sha256_Process(Sha256_Ctx_t *const ctx)
 		a = tmp_1 + tmp_2;
 	}
 
+#elif (CONFIG_SHA256_PROFILE == CONFIG_SHA256_PROFILE_SPEED)
+	uint32_t *const W = &ctx->W[0u];
+
+	// Rounds 0 to 15 directly consume the message words (taking byte order adjustments into account)
+	for (uint32_t j = 0u; j < 16u; ++j)
+	{
+		W[j] = __REV(block[j]);
+	}
+
+	// Iterate the round functions in groups of 16 rounds (two full rotations of the working variables)
+	for (uint32_t r = 0u; r < 64u; r += 16u)
+	{
+		const uint32_t *const K = &gkSha256_K[r];
+
+		SHA256_ROUND(a, b, c, d, e, f, g, h,  0u);
+		SHA256_ROUND(h, a, b, c, d, e, f, g,  1u);
+		SHA256_ROUND(g, h, a, b, c, d, e, f,  2u);
+		SHA256_ROUND(f, g, h, a, b, c, d, e,  3u);
+		SHA256_ROUND(e, f, g, h, a, b, c, d,  4u);
+		SHA256_ROUND(d, e, f, g, h, a, b, c,  5u);
+		SHA256_ROUND(c, d, e, f, g, h, a, b,  6u);
+		SHA256_ROUND(b, c, d, e, f, g, h, a,  7u);
+		SHA256_ROUND(a, b, c, d, e, f, g, h,  8u);
+		SHA256_ROUND(h, a, b, c, d, e, f, g,  9u);
+		SHA256_ROUND(g, h, a, b, c, d, e, f, 10u);
+		SHA256_ROUND(f, g, h, a, b, c, d, e, 11u);
+		SHA256_ROUND(e, f, g, h, a, b, c, d, 12u);
+		SHA256_ROUND(d, e, f, g, h, a, b, c, 13u);
+		SHA256_ROUND(c, d, e, f, g, h, a, b, 14u);
+		SHA256_ROUND(b, c, d, e, f, g, h, a, 15u);
+	}
+#endif
+
 	// Update the hash state
 	ctx->H[0u] += a;
 	ctx->H[1u] += b;
@@ -176,19 +283,86 @@ static void Sha256_Process(Sha256_Ctx_t *const ctx)
 	ctx->H[6u] += g;
 	ctx->H[7u] += h;
 
-	// Clear the word buffer
-	//
-	// This serves a twofold purpose: Firstly we reduce the risk of information leakage, and secondly we simplify
-	// handling of the final padding (as unused parts of the buffer are always zeroed out).
-	//
-	__builtin_memset(&ctx->W[0u], 0u, sizeof(ctx->W));
+#if (CONFIG_SHA256_STATS != 0)
+	++gSha256_NumCompressions;
+#endif
 }
 
 //---------------------------------------------------------------------------------------------------------------------
-__USED void Sha256_Init(void)
+/**
+ * @brief Processes a constant message block with a precomputed message schedule.
+ *
+ * @param[in] ctx is the SHA-256 hash context to be used.
+ * @param[in] KW points to the precomputed sums K[i] + W[i] (for rounds 0..63) of the constant block.
+ */
+static void Sha256_ProcessPrescheduledBlock(Sha256_Ctx_t *const ctx, const uint32_t KW[64u])
+{
+	// Load the working variables from the current hash state
+	uint32_t a = ctx->H[0u];
+	uint32_t b = ctx->H[1u];
+	uint32_t c = ctx->H[2u];
+	uint32_t d = ctx->H[3u];
+	uint32_t e = ctx->H[4u];
+	uint32_t f = ctx->H[5u];
+	uint32_t g = ctx->H[6u];
+	uint32_t h = ctx->H[7u];
+
+	// Iterate the round functions (no message schedule needed)
+	for (uint32_t i = 0u; i <= 63u; ++i)
+	{
+		const uint32_t S0    = ROR(a, 2u) ^ ROR(a, 13u) ^ ROR(a, 22u);
+		const uint32_t S1    = ROR(e, 6u) ^ ROR(e, 11u) ^ ROR(e, 25u);
+		const uint32_t ch    = ( e & f) ^ (~e & g);
+		const uint32_t maj   = (a & b) ^ ( a & c) ^ (b & c);
+		const uint32_t tmp_1 = h + S1 + ch + KW[i];
+		const uint32_t tmp_2 = S0 + maj;
+
+		h = g;
+		g = f;
+		f = e;
+		e = d + tmp_1;
+		d = c;
+		c = b;
+		b = a;
+		a = tmp_1 + tmp_2;
+	}
+
+	// Update the hash state
+	ctx->H[0u] += a;
+	ctx->H[1u] += b;
+	ctx->H[2u] += c;
+	ctx->H[3u] += d;
+	ctx->H[4u] += e;
+	ctx->H[5u] += f;
+	ctx->H[6u] += g;
+	ctx->H[7u] += h;
+
+#if (CONFIG_SHA256_STATS != 0)
+	++gSha256_NumCompressions;
+#endif
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+/**
+ * @brief Copies out the final hash value of a SHA context (and re-initializes the context).
+ */
+static void Sha256_OutputDigest(Sha256_Ctx_t *const ctx, uint8_t digest[SHA256_HASH_LENGTH_BYTES])
 {
-	Sha256_Ctx_t *const ctx = &gSha256;
+	// Copy out the final hash
+	for (uint32_t i = 0u; i < 8u; ++i)
+	{
+		__UNALIGNED_UINT32_WRITE(&digest[i * 4u], __REV(ctx->H[i]));
+	}
+
+	// Re-initialize the hash context
+	//
+	// This also clears the word buffer (which reduces the risk of information leakage).
+	Sha256_InitCtx(ctx);
+}
 
+//---------------------------------------------------------------------------------------------------------------------
+__USED void Sha256_InitCtx(Sha256_Ctx_t *const ctx)
+{
 	// Setup the initial hash value
 	__builtin_memcpy(&ctx->H[0u], &gkSha256_IV[0u], SHA256_HASH_LENGTH_BYTES);
 
@@ -200,10 +374,8 @@ __USED void Sha256_Init(void)
 }
 
 //---------------------------------------------------------------------------------------------------------------------
-__USED void Sha256_Update(const void *const data, const uint32_t size)
+__USED void Sha256_UpdateCtx(Sha256_Ctx_t *const ctx, const void *const data, const uint32_t size)
 {
-	Sha256_Ctx_t *const ctx = &gSha256;
-
 	const uint8_t *src = (const uint8_t *) data;
 	uint32_t remaining = size;
 
@@ -218,14 +390,23 @@ __USED void Sha256_Update(const void *const data, const uint32_t size)
 		const uint32_t buf_capacity    = sizeof(ctx->W) - buf_offset;
 		const uint32_t size_to_process = (remaining < buf_capacity) ? remaining : buf_capacity;
 
-		// Fill the word buffer
-		uint8_t *const buf_data = (uint8_t *) &ctx->W[0u];
-		__builtin_memcpy(buf_data + buf_offset, src, size_to_process);
-
-		// Flush the block if needed
-		if (sizeof(ctx->W) == (buf_offset + size_to_process))
+		if ((0u == buf_offset) && (sizeof(ctx->W) == size_to_process) && (0u == (((uintptr_t) src) & 3u)))
+		{
+			// Fast path: The word buffer is empty and we have a full (word-aligned) block. Process the block
+			// directly from the source buffer (without copying it to the word buffer first).
+			Sha256_ProcessBlock(ctx, (const uint32_t *) src);
+		}
+		else
 		{
-			Sha256_Process(ctx);
+			// Fill the word buffer
+			uint8_t *const buf_data = (uint8_t *) &ctx->W[0u];
+			__builtin_memcpy(buf_data + buf_offset, src, size_to_process);
+
+			// Flush the block if needed
+			if (sizeof(ctx->W) == (buf_offset + size_to_process))
+			{
+				Sha256_ProcessBlock(ctx, &ctx->W[0u]);
+			}
 		}
 
 		// Advance the source pointer and the remaining size
@@ -236,26 +417,27 @@ __USED void Sha256_Update(const void *const data, const uint32_t size)
 }
 
 //---------------------------------------------------------------------------------------------------------------------
-__USED void Sha256_Final(uint8_t digest[SHA256_HASH_LENGTH_BYTES])
+__USED void Sha256_FinalCtx(Sha256_Ctx_t *const ctx, uint8_t digest[SHA256_HASH_LENGTH_BYTES])
 {
-	Sha256_Ctx_t *const ctx = &gSha256;
-
 	// Append the 0x80 padding byte
 	const uint8_t padding_byte = UINT8_C(0x80);
-	Sha256_Update(&padding_byte, 1);
+	Sha256_UpdateCtx(ctx, &padding_byte, 1);
+
+	// Zero-pad the remainder of the word buffer (the word buffer is clobbered by previously processed blocks)
+	const uint32_t buf_offset = ctx->msg_length % sizeof(ctx->W);
+	uint8_t *const buf_data = (uint8_t *) &ctx->W[0u];
+	__builtin_memset(buf_data + buf_offset, 0u, sizeof(ctx->W) - buf_offset);
 
 	// We explicitly need to flush the buffer if the remaining buffer capacity is less than 8 bytes
 	// (which we need for the final bit counter).
-	if ((ctx->msg_length % sizeof(ctx->W)) > (sizeof(ctx->W) - 8u))
+	if (buf_offset > (sizeof(ctx->W) - 8u))
 	{
-		Sha256_Process(ctx);
+		Sha256_ProcessBlock(ctx, &ctx->W[0u]);
+		__builtin_memset(&ctx->W[0u], 0u, sizeof(ctx->W));
 	}
 
 	// Append the bit (sic!) size of the message and process the final block.
 	//
-	// Note that our BUG5_Sha256_Process() ensures that the W buffer is cleared after processing a block, which
-	// as a side effect guarantees proper zero padding for us.
-	//
 	// FIXME: This implementation currently does not provide any special handling for larger buffers that exceed
 	// the 32-bit limit for bit-sizes.
 	//
@@ -263,76 +445,216 @@ __USED void Sha256_Final(uint8_t digest[SHA256_HASH_LENGTH_BYTES])
 	ctx->W[15u] = __REV((ctx->msg_length - 1u) << 3u);
 
 	// Process the final block
-	Sha256_Process(ctx);
+	Sha256_ProcessBlock(ctx, &ctx->W[0u]);
 
-	// Copy out the final hash
-	for (uint32_t i = 0u; i < 8u; ++i)
-	{
-		__UNALIGNED_UINT32_WRITE(&digest[i * 4u], __REV(ctx->H[i]));
-	}
-
-	// Re-initialize the hash context
-	Sha256_Init();
+	// Copy out the final hash (and re-initialize the hash context)
+	Sha256_OutputDigest(ctx, digest);
 }
 
 //---------------------------------------------------------------------------------------------------------------------
-__USED void Sha256_HmacInit(const uint8_t *const key, const uint32_t key_len)
+void Sha256_ExtendCtx(Sha256_Ctx_t *const ctx, uint8_t digest[SHA256_HASH_LENGTH_BYTES], const void *const data, const uint32_t size)
 {
-	Sha256_Ctx_t *const ctx = &gSha256;
+	const uint32_t msg_length = SHA256_HASH_LENGTH_BYTES + size;
 
-	// Initialize the hash context
-	Sha256_Init();
+	// Start a new hash (this also zero-pads the word buffer) with the old digest
+	Sha256_InitCtx(ctx);
 
-	// Zero the padding
-	__builtin_memset(&ctx->pad[0u], 0u, SHA256_HASH_BLOCK_LENGTH_BYTES);
+	uint8_t *const buf_data = (uint8_t *) &ctx->W[0u];
+	__builtin_memcpy(buf_data, &digest[0u], SHA256_HASH_LENGTH_BYTES);
 
-	if (key_len > SHA256_HASH_BLOCK_LENGTH_BYTES)
+	if (size <= (SHA256_HASH_BLOCK_LENGTH_BYTES - SHA256_HASH_LENGTH_BYTES - 9u))
 	{
-		// Key length is greater than block size (need to hash once)
-		Sha256_Update(key, key_len);
-		Sha256_Final(&ctx->pad[0u]);
+		// Single block: Old digest, data, 0x80 padding byte and the message length (in bits) fit into one block
+		__builtin_memcpy(buf_data + SHA256_HASH_LENGTH_BYTES, data, size);
+		buf_data[msg_length] = UINT8_C(0x80);
+		ctx->W[15u] = __REV(msg_length << 3u);
+
+		Sha256_ProcessBlock(ctx, &ctx->W[0u]);
+		Sha256_OutputDigest(ctx, digest);
+	}
+	else if (size == SHA256_HASH_LENGTH_BYTES)
+	{
+		// Two blocks: Old digest and new digest form the first block, the second block is the constant padding
+		// block of a 64-byte message (with precomputed message schedule)
+		__builtin_memcpy(buf_data + SHA256_HASH_LENGTH_BYTES, data, size);
+
+		Sha256_ProcessBlock(ctx, &ctx->W[0u]);
+		Sha256_ProcessPrescheduledBlock(ctx, &gkSha256_KW_Pad64[0u]);
+		Sha256_OutputDigest(ctx, digest);
 	}
 	else
 	{
-		// Copy the key (and pad with zeros)
-		__builtin_memcpy(&ctx->pad[0u], &key[0u], key_len);
+		// Generic case
+		ctx->msg_length = SHA256_HASH_LENGTH_BYTES;
+		Sha256_UpdateCtx(ctx, data, size);
+		Sha256_FinalCtx(ctx, digest);
 	}
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+/**
+ * @brief Starts a new hash with a single key block (key XOR pad byte).
+ *
+ * @param[in] ctx is the SHA-256 hash context to be used.
+ * @param[in] key points to the first byte of the (short) HMAC key.
+ * @param[in] key_len is the length of the HMAC key in bytes (at most one block).
+ * @param[in] pad_byte is the ipad (0x36) or opad (0x5C) byte value.
+ */
+static void Sha256_HmacAbsorbKeyBlock(Sha256_Ctx_t *const ctx, const uint8_t *const key, const uint32_t key_len, const uint8_t pad_byte)
+{
+	// Start a new hash (this also zero-pads the word buffer)
+	Sha256_InitCtx(ctx);
+
+	// Build the key block directly in the word buffer
+	uint8_t *const buf_data = (uint8_t *) &ctx->W[0u];
+	__builtin_memcpy(buf_data, &key[0u], key_len);
 
-	// Prepare the ipad value
 	for (size_t i = 0u; i < SHA256_HASH_BLOCK_LENGTH_BYTES; ++i)
 	{
-		ctx->pad[i] ^= 0x36u;
+		buf_data[i] ^= pad_byte;
 	}
 
-	// Start the inner hash (with ipad)
-	Sha256_Update(&ctx->pad[0u], SHA256_HASH_BLOCK_LENGTH_BYTES);
+	// And process the block
+	ctx->msg_length = SHA256_HASH_BLOCK_LENGTH_BYTES;
+	Sha256_ProcessBlock(ctx, &ctx->W[0u]);
+}
 
-	// Prepare the opad value
-	for (size_t i = 0u; i < SHA256_HASH_BLOCK_LENGTH_BYTES; ++i)
+//---------------------------------------------------------------------------------------------------------------------
+__USED void Sha256_HmacInitCtx(Sha256_Ctx_t *const ctx, const uint8_t *const key, const uint32_t key_len)
+{
+	const uint8_t *key_data = key;
+	uint32_t key_size = key_len;
+	uint8_t key_digest[SHA256_HASH_LENGTH_BYTES];
+
+	if (key_len > SHA256_HASH_BLOCK_LENGTH_BYTES)
 	{
-		ctx->pad[i] ^= (0x36u ^ 0x5Cu);
+		// Key length is greater than block size (need to hash once)
+		Sha256_InitCtx(ctx);
+		Sha256_UpdateCtx(ctx, key, key_len);
+		Sha256_FinalCtx(ctx, &key_digest[0u]);
+
+		key_data = &key_digest[0u];
+		key_size = SHA256_HASH_LENGTH_BYTES;
 	}
+
+	// Absorb the opad block and keep the resulting outer chaining value
+	Sha256_HmacAbsorbKeyBlock(ctx, key_data, key_size, 0x5Cu);
+	__builtin_memcpy(&ctx->H_outer[0u], &ctx->H[0u], sizeof(ctx->H_outer));
+
+	// Start the inner hash (with ipad)
+	Sha256_HmacAbsorbKeyBlock(ctx, key_data, key_size, 0x36u);
+
+	// And clear the hashed key (if any)
+	__builtin_memset(&key_digest[0u], 0u, sizeof(key_digest));
 }
 
 //---------------------------------------------------------------------------------------------------------------------
-__USED void Sha256_HmacUpdate(const void *const data, const uint32_t size)
+void Sha256_HmacExportStateCtx(const Sha256_Ctx_t *const ctx, Sha256_HmacState_t *const state)
 {
-	Sha256_Update(data, size);
+	// Save the inner chaining value (the ipad block has already been absorbed by Sha256_HmacInit)
+	__builtin_memcpy(&state->inner[0u], &ctx->H[0u], sizeof(state->inner));
+
+	// Save the outer chaining value
+	__builtin_memcpy(&state->outer[0u], &ctx->H_outer[0u], sizeof(state->outer));
 }
 
 //---------------------------------------------------------------------------------------------------------------------
-__USED void Sha256_HmacFinal(uint8_t digest[SHA256_HASH_LENGTH_BYTES])
+void Sha256_HmacImportStateCtx(Sha256_Ctx_t *const ctx, const Sha256_HmacState_t *const state)
 {
-	Sha256_Ctx_t *const ctx = &gSha256;
+	// Resume the inner hash (after the ipad block)
+	Sha256_InitCtx(ctx);
+	__builtin_memcpy(&ctx->H[0u], &state->inner[0u], sizeof(ctx->H));
+	ctx->msg_length = SHA256_HASH_BLOCK_LENGTH_BYTES;
+
+	// Restore the outer chaining value
+	__builtin_memcpy(&ctx->H_outer[0u], &state->outer[0u], sizeof(ctx->H_outer));
+}
 
+//---------------------------------------------------------------------------------------------------------------------
+__USED void Sha256_HmacUpdateCtx(Sha256_Ctx_t *const ctx, const void *const data, const uint32_t size)
+{
+	Sha256_UpdateCtx(ctx, data, size);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+__USED void Sha256_HmacFinalCtx(Sha256_Ctx_t *const ctx, uint8_t digest[SHA256_HASH_LENGTH_BYTES])
+{
 	// Finalize the inner hash
-	Sha256_Final(digest);
+	Sha256_FinalCtx(ctx, digest);
 
-	// Now compute the outer hash
-	Sha256_Update(&ctx->pad[0u], SHA256_HASH_BLOCK_LENGTH_BYTES);
-	Sha256_Update(digest, SHA256_HASH_LENGTH_BYTES);
-	Sha256_Final(digest);
+	// Now compute the outer hash (resume after the opad block)
+	__builtin_memcpy(&ctx->H[0u], &ctx->H_outer[0u], sizeof(ctx->H));
+	ctx->msg_length = SHA256_HASH_BLOCK_LENGTH_BYTES;
+
+	Sha256_UpdateCtx(ctx, digest, SHA256_HASH_LENGTH_BYTES);
+	Sha256_FinalCtx(ctx, digest);
 
 	// And done
-	__builtin_memset(&ctx->pad[0u], 0u, SHA256_HASH_BLOCK_LENGTH_BYTES);
+	__builtin_memset(&ctx->H_outer[0u], 0u, sizeof(ctx->H_outer));
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// Context-less API (operates on the global singleton context)
+//
+
+//---------------------------------------------------------------------------------------------------------------------
+__USED void Sha256_Init(void)
+{
+	Sha256_InitCtx(&gSha256);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+__USED void Sha256_Update(const void *const data, const uint32_t size)
+{
+	Sha256_UpdateCtx(&gSha256, data, size);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+__USED void Sha256_Final(uint8_t digest[SHA256_HASH_LENGTH_BYTES])
+{
+	Sha256_FinalCtx(&gSha256, digest);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void Sha256_Extend(uint8_t digest[SHA256_HASH_LENGTH_BYTES], const void *const data, const uint32_t size)
+{
+	Sha256_ExtendCtx(&gSha256, digest, data, size);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+__USED void Sha256_HmacInit(const uint8_t *const key, const uint32_t key_len)
+{
+	Sha256_HmacInitCtx(&gSha256, key, key_len);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void Sha256_HmacExportState(Sha256_HmacState_t *const state)
+{
+	Sha256_HmacExportStateCtx(&gSha256, state);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void Sha256_HmacImportState(const Sha256_HmacState_t *const state)
+{
+	Sha256_HmacImportStateCtx(&gSha256, state);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+__USED void Sha256_HmacUpdate(const void *const data, const uint32_t size)
+{
+	Sha256_HmacUpdateCtx(&gSha256, data, size);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+__USED void Sha256_HmacFinal(uint8_t digest[SHA256_HASH_LENGTH_BYTES])
+{
+	Sha256_HmacFinalCtx(&gSha256, digest);
+}
+
+#if (CONFIG_SHA256_STATS != 0)
+//---------------------------------------------------------------------------------------------------------------------
+uint32_t Sha256_GetCompressionCount(void)
+{
+	return gSha256_NumCompressions;
 }
+#endif
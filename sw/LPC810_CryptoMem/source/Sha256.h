@@ -19,6 +19,148 @@
  */
 #define SHA256_HASH_BLOCK_LENGTH_BYTES (64u)
 
+/**
+ * @brief Precomputed state of a keyed SHA-256 HMAC context.
+ *
+ * The state captures the SHA-256 chaining values after absorbing the ipad and the opad block of a given key. An
+ * HMAC context can be resumed from this state without access to the key (and without the two compressions needed
+ * for the ipad and opad blocks).
+ */
+typedef struct
+{
+	/**
+	 * @brief Chaining value of the inner hash (after the ipad block)
+	 */
+	uint32_t inner[8u];
+
+	/**
+	 * @brief Chaining value of the outer hash (after the opad block)
+	 */
+	uint32_t outer[8u];
+} Sha256_HmacState_t;
+
+
+/**
+ * @brief SHA-256 (and HMAC) calculation context
+ *
+ * Contexts can be placed anywhere in (word-aligned) memory by the caller. All members are private to the
+ * SHA-256 implementation.
+ */
+typedef struct
+{
+	/**
+	 * @brief Hash state variables
+	 */
+	uint32_t H[8u];
+
+	/**
+	 * @brief Message word buffer (for circular word schedule)
+	 */
+	uint32_t W[16u];
+
+	/**
+	 * @brief Total length of the message in byte
+	 */
+	uint32_t msg_length;
+
+	/**
+	 * @brief Chaining value of the outer hash after the opad block (in HMAC calculations)
+	 */
+	uint32_t H_outer[8u];
+} Sha256_Ctx_t;
+
+/**
+ * @brief Initializes a SHA-256 hash context for the hash calculation.
+ *
+ * @param[out] ctx is the SHA-256 hash context to be initialized.
+ */
+extern void Sha256_InitCtx(Sha256_Ctx_t *const ctx);
+
+/**
+ * @brief Updates a SHA-256 hash context with additional hash data.
+ *
+ * @param[in,out] ctx is the SHA-256 hash context to be updated.
+ * @param[in] data points to the data buffer to be hashed.
+ * @param[in] size specifies the length (in bytes) of the data buffer to be hashed.
+ */
+extern void Sha256_UpdateCtx(Sha256_Ctx_t *const ctx, const void *const data, const uint32_t size);
+
+/**
+ * @brief Finalizes a SHA-256 hash context.
+ *
+ * @param[in,out] ctx is the SHA-256 hash context to be finalized.
+ * @param[out] digest is points to the location to copy the final digest to.
+ *
+ * @remarks This function reinitializes the hash context using a
+ *   call to @ref Sha256_InitCtx after the calculation is done.
+ */
+extern void Sha256_FinalCtx(Sha256_Ctx_t *const ctx, uint8_t digest[SHA256_HASH_LENGTH_BYTES]);
+
+/**
+ * @brief Extends a digest with additional data (digest := SHA-256(digest || data)).
+ *
+ * @param[in,out] ctx is the SHA-256 hash context to be used (re-initialized on return).
+ * @param[in,out] digest is the digest to be extended (updated in place).
+ * @param[in] data points to the data buffer to be appended.
+ * @param[in] size specifies the length (in bytes) of the data buffer to be appended.
+ *
+ * @remarks Data of up to 23 bytes (single block), and data of exactly 32 bytes (two blocks, with a
+ *   precomputed message schedule for the constant second block) are processed without any buffer
+ *   management. Other sizes fall back to the generic update/finalize sequence.
+ */
+extern void Sha256_ExtendCtx(Sha256_Ctx_t *const ctx, uint8_t digest[SHA256_HASH_LENGTH_BYTES], const void *const data, const uint32_t size);
+
+/**
+ * @brief Initializes a SHA-256 HMAC context.
+ *
+ * @param[out] ctx is the SHA-256 hash context to be initialized.
+ * @param[in] key points to the first byte of the HMAC key.
+ * @param[in] key_len is the length of the HMAC key in bytes.
+ */
+extern void Sha256_HmacInitCtx(Sha256_Ctx_t *const ctx, const uint8_t *const key, const uint32_t key_len);
+
+/**
+ * @brief Exports the keyed state of a freshly initialized SHA-256 HMAC context.
+ *
+ * @param[in] ctx is the SHA-256 HMAC context.
+ * @param[out] state receives the inner and outer chaining values of the HMAC context.
+ *
+ * @remarks This function must be called directly after @ref Sha256_HmacInitCtx (before any
+ *   data is added via @ref Sha256_HmacUpdateCtx). The HMAC context is left unchanged.
+ */
+extern void Sha256_HmacExportStateCtx(const Sha256_Ctx_t *const ctx, Sha256_HmacState_t *const state);
+
+/**
+ * @brief Initializes a SHA-256 HMAC context from a previously exported keyed state.
+ *
+ * @param[out] ctx is the SHA-256 HMAC context to be initialized.
+ * @param[in] state points to the keyed state (see @ref Sha256_HmacExportStateCtx).
+ */
+extern void Sha256_HmacImportStateCtx(Sha256_Ctx_t *const ctx, const Sha256_HmacState_t *const state);
+
+/**
+ * @brief Updates a SHA-256 HMAC context with additional hash data.
+ *
+ * @param[in,out] ctx is the SHA-256 HMAC context to be updated.
+ * @param[in] data points to the data buffer to be hashed.
+ * @param[in] size specifies the length (in bytes) of the data buffer to be hashed.
+ */
+extern void Sha256_HmacUpdateCtx(Sha256_Ctx_t *const ctx, const void *const data, const uint32_t size);
+
+/**
+ * @brief Finalizes a SHA-256 HMAC context.
+ *
+ * @param[in,out] ctx is the SHA-256 HMAC context to be finalized.
+ * @param[out] digest is points to the location to copy the final HMAC to.
+ */
+extern void Sha256_HmacFinalCtx(Sha256_Ctx_t *const ctx, uint8_t digest[SHA256_HASH_LENGTH_BYTES]);
+
+//
+// Context-less API
+//
+// The following functions operate on a global (singleton) SHA-256 context. They are thin wrappers around the
+// corresponding context-based functions.
+//
 
 /**
  * @brief Initializes a SHA-256 hash context for the hash calculation.
@@ -43,6 +185,15 @@ extern void Sha256_Update(const void *const data, const uint32_t size);
  */
 extern void Sha256_Final(uint8_t digest[SHA256_HASH_LENGTH_BYTES]);
 
+/**
+ * @brief Extends a digest with additional data (digest := SHA-256(digest || data)).
+ *
+ * @param[in,out] digest is the digest to be extended (updated in place).
+ * @param[in] data points to the data buffer to be appended.
+ * @param[in] size specifies the length (in bytes) of the data buffer to be appended.
+ */
+extern void Sha256_Extend(uint8_t digest[SHA256_HASH_LENGTH_BYTES], const void *const data, const uint32_t size);
+
 /**
  * @brief Initializes a SHA-256 HMAC context.
  *
@@ -51,6 +202,23 @@ extern void Sha256_Final(uint8_t digest[SHA256_HASH_LENGTH_BYTES]);
  */
 extern void Sha256_HmacInit(const uint8_t *const key, const uint32_t key_len);
 
+/**
+ * @brief Exports the keyed state of a freshly initialized SHA-256 HMAC context.
+ *
+ * @param[out] state receives the inner and outer chaining values of the HMAC context.
+ *
+ * @remarks This function must be called directly after @ref Sha256_HmacInit (before any
+ *   data is added via @ref Sha256_HmacUpdate). The HMAC context is left unchanged.
+ */
+extern void Sha256_HmacExportState(Sha256_HmacState_t *const state);
+
+/**
+ * @brief Initializes a SHA-256 HMAC context from a previously exported keyed state.
+ *
+ * @param[in] state points to the keyed state (see @ref Sha256_HmacExportState).
+ */
+extern void Sha256_HmacImportState(const Sha256_HmacState_t *const state);
+
 /**
  * @brief Updates a SHA-256 HMAC context with additional hash data.
  *
@@ -66,4 +234,11 @@ extern void Sha256_HmacUpdate(const void *const data, const uint32_t size);
  */
 extern void Sha256_HmacFinal(uint8_t digest[SHA256_HASH_LENGTH_BYTES]);
 
+/**
+ * @brief Gets the number of SHA-256 compression function invocations since startup.
+ *
+ * @remarks Only available if CONFIG_SHA256_STATS is enabled.
+ */
+extern uint32_t Sha256_GetCompressionCount(void);
+
 #endif /* SHA256_H_ */
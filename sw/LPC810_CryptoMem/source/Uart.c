@@ -239,7 +239,12 @@ static uint8_t Eep_UartSlaveRead(void)
 	for (uint32_t i = 0u; i < reg_cnt; ++i)
 	{
 		/// Transmit
+#if (CONFIG_CRYPTOMEM_REGISTER_MAP_V2 != 0)
+		uint8_t tx_byte = Eep_ByteReadCallback(reg_addr);
+		reg_addr = Eep_NextReadAddressCallback(reg_addr);
+#else
 		uint8_t tx_byte = Eep_ByteReadCallback((reg_addr + i) & 0xFFu);
+#endif
 		Eep_UartWriteHexByte(tx_byte);
 	}
 
@@ -0,0 +1,214 @@
+/**
+ * @file
+ * @brief Host benchmarks of the command layer
+ *
+ * The benchmarks drive the command layer through the EEP byte callbacks (like the wired interface does) and report
+ * the execution time and the number of SHA-256 compressions of each command. The compression count of every command
+ * is checked against its budget; a change that makes a command more expensive fails the benchmark.
+ */
+#include <Config.h>
+#include <Hal.h>
+#include <Eep.h>
+#include <Sha256.h>
+
+#include "TestUtil.h"
+
+// Command layer entry points (see CryptoMem.c)
+extern void CryptoMem_Init(void);
+extern void CryptoMem_HandleCommand(void);
+
+// Offsets of the command registers (default register map)
+#define REG_ARG_0 UINT8_C(0x50)
+#define REG_ARG_1 UINT8_C(0x51)
+#define REG_CMD   UINT8_C(0x53)
+#define REG_STAT  UINT8_C(0x54)
+#define REG_RET_0 UINT8_C(0x55)
+
+// Compressions needed to key the HMAC engine with a device key (key derivation plus ipad/opad blocks)
+#if (CONFIG_CRYPTOMEM_KEY_CACHE == CONFIG_CRYPTOMEM_KEY_CACHE_NONE)
+# define BENCH_DEVICE_KEY_COMPRESSIONS (6u)
+#else
+# define BENCH_DEVICE_KEY_COMPRESSIONS (0u)
+#endif
+
+/**
+ * @brief Number of SHA-256 blocks of a message (including the padding and the length field).
+ */
+static uint32_t Bench_Blocks(const uint32_t length)
+{
+	return (length + 9u + (SHA256_HASH_BLOCK_LENGTH_BYTES - 1u)) / SHA256_HASH_BLOCK_LENGTH_BYTES;
+}
+
+/**
+ * @brief Compression budget of a HMAC with a device key (excluding the key setup).
+ *
+ * The key setup absorbs the ipad and the opad block. The remaining inner blocks of the (ipad || message) hash plus
+ * the final outer compression add up to the block count of the inner hash.
+ */
+static uint32_t Bench_HmacBudget(const uint32_t length)
+{
+	return BENCH_DEVICE_KEY_COMPRESSIONS + Bench_Blocks(SHA256_HASH_BLOCK_LENGTH_BYTES + length);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+/**
+ * @brief Executes a command (through the EEP byte callbacks).
+ *
+ * @param[in] cmd is the command code.
+ * @param[in] arg0 is the value of ARG_0.
+ * @param[in] arg1 is the value of ARG_1.
+ * @param[in] data points to the DATA input (may be NULL if data_len is zero).
+ * @param[in] data_len is the length of the DATA input.
+ *
+ * @return Return code (RET_0) of the command.
+ */
+static uint8_t Bench_Command(const uint8_t cmd, const uint8_t arg0, const uint8_t arg1, const void *const data, const uint32_t data_len)
+{
+	for (uint32_t i = 0u; i < data_len; ++i)
+	{
+		Eep_ByteWriteCallback((uint8_t) i, ((const uint8_t *) data)[i]);
+	}
+
+	Eep_ByteWriteCallback(REG_ARG_0, arg0);
+	Eep_ByteWriteCallback(REG_ARG_1, arg1);
+	Eep_ByteWriteCallback(REG_CMD, cmd);
+
+	CryptoMem_HandleCommand();
+
+	TEST_CHECK(Eep_ByteReadCallback(REG_STAT) != UINT8_C(0xFF));
+	return Eep_ByteReadCallback(REG_RET_0);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+/**
+ * @brief Benchmarks a command (and checks its compression budget).
+ */
+static void Bench_RunCommand(const char *name, const uint8_t cmd, const uint8_t arg0, const uint8_t arg1,
+	const void *const data, const uint32_t data_len, const uint32_t budget, const uint32_t iterations)
+{
+	const uint32_t compressions = Sha256_GetCompressionCount();
+
+	uint32_t elapsed = 0u;
+	for (uint32_t i = 0u; i < iterations; ++i)
+	{
+		const uint32_t start = Sha256_GetCompressionCount();
+
+		Hal_StartCycleCounter();
+		TEST_CHECK(Bench_Command(cmd, arg0, arg1, data, data_len) == 0x00u);
+		elapsed += Hal_ReadCycleCounter();
+
+		TEST_CHECK((Sha256_GetCompressionCount() - start) <= budget);
+	}
+
+	TestUtil_Report(name, elapsed, Sha256_GetCompressionCount() - compressions, iterations);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+static void Bench_Hmac(void)
+{
+	static const uint8_t kKey[SHA256_HASH_LENGTH_BYTES] = { 0x42u };
+	const uint32_t kIterations = 10000u;
+
+	uint8_t mac[SHA256_HASH_LENGTH_BYTES];
+	const uint32_t compressions = Sha256_GetCompressionCount();
+
+	Hal_StartCycleCounter();
+	for (uint32_t i = 0u; i < kIterations; ++i)
+	{
+		Sha256_HmacInit(kKey, sizeof(kKey));
+		Sha256_HmacFinal(mac);
+	}
+	const uint32_t elapsed = Hal_ReadCycleCounter();
+
+	// ipad block, opad block, inner final block and outer final block
+	TEST_CHECK((Sha256_GetCompressionCount() - compressions) == 4u * kIterations);
+	TestUtil_Report("Sha256_HmacInit/Final", elapsed, Sha256_GetCompressionCount() - compressions, kIterations);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+static void Bench_Extend(void)
+{
+	static const uint32_t kLengths[] = { 0u, 20u, 32u, 64u, 80u };
+	static const char *const kNames[] = { "Extend (0 bytes)", "Extend (20 bytes)", "Extend (32 bytes)", "Extend (64 bytes)", "Extend (80 bytes)" };
+
+	uint8_t data[80u];
+	TestUtil_Random(data, sizeof(data));
+
+	for (uint32_t n = 0u; n < (sizeof(kLengths) / sizeof(kLengths[0u])); ++n)
+	{
+		Bench_RunCommand(kNames[n], 0xE0u, 0x00u, (uint8_t) kLengths[n], data, kLengths[n],
+			Bench_Blocks(SHA256_HASH_LENGTH_BYTES + kLengths[n]), 1000u);
+	}
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+static void Bench_Quote(void)
+{
+	static const uint32_t kExtraLengths[] = { 0u, 32u, 80u };
+	static const char *const kNames[] = { "Quote (all masks, 0 bytes)", "Quote (all masks, 32 bytes)", "Quote (all masks, 80 bytes)" };
+
+	uint8_t data[80u];
+	TestUtil_Random(data, sizeof(data));
+
+	for (uint32_t n = 0u; n < (sizeof(kExtraLengths) / sizeof(kExtraLengths[0u])); ++n)
+	{
+		const uint32_t compressions = Sha256_GetCompressionCount();
+		uint32_t elapsed = 0u;
+
+		for (uint32_t mask = 0u; mask <= 0xFFu; ++mask)
+		{
+			// Length of the MACed quote message (header, selected state and extra data)
+			uint32_t length = 2u * sizeof(uint32_t) + kExtraLengths[n];
+			length += ((mask & 0x80u) != 0u) ? 16u : 0u;                      // Device UID
+			length += ((mask & 0x40u) != 0u) ?  8u : 0u;                      // Volatile bits and locks
+			length += ((mask & 0x20u) != 0u) ?  4u : 0u;                      // Volatile counter #1
+			length += ((mask & 0x10u) != 0u) ?  4u : 0u;                      // Volatile counter #0
+			length += ((mask & 0x08u) != 0u) ? 32u : 0u;                      // User data
+			length += (uint32_t) __builtin_popcount(mask & 0x07u) * 32u;      // PCRs
+
+			const uint32_t start = Sha256_GetCompressionCount();
+			Hal_StartCycleCounter();
+			TEST_CHECK(Bench_Command(0xA0u, (uint8_t) mask, (uint8_t) kExtraLengths[n], data, kExtraLengths[n]) == 0x00u);
+			elapsed += Hal_ReadCycleCounter();
+
+			TEST_CHECK((Sha256_GetCompressionCount() - start) <= Bench_HmacBudget(length));
+		}
+
+		TestUtil_Report(kNames[n], elapsed, Sha256_GetCompressionCount() - compressions, 256u);
+	}
+
+	// Typical quote (all PCRs, device UID, with a 32-byte nonce)
+	Bench_RunCommand("Quote (0x87, 32 bytes)", 0xA0u, 0x87u, 32u, data, 32u,
+		Bench_HmacBudget(2u * sizeof(uint32_t) + 16u + 3u * 32u + 32u), 1000u);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+static void Bench_Hkdf(void)
+{
+	static const uint32_t kLengths[] = { 0u, 32u, 80u };
+	static const char *const kNames[] = { "HKDF (0 bytes)", "HKDF (32 bytes)", "HKDF (80 bytes)" };
+
+	uint8_t seed[80u];
+	TestUtil_Random(seed, sizeof(seed));
+
+	for (uint32_t n = 0u; n < (sizeof(kLengths) / sizeof(kLengths[0u])); ++n)
+	{
+		Bench_RunCommand(kNames[n], 0xB0u, (uint8_t) kLengths[n], 0x00u, seed, kLengths[n],
+			Bench_HmacBudget(kLengths[n]), 1000u);
+	}
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+int main(void)
+{
+	TestUtil_Begin("CryptoMem command benchmarks");
+
+	CryptoMem_Init();
+
+	Bench_Hmac();
+	Bench_Extend();
+	Bench_Quote();
+	Bench_Hkdf();
+
+	return TestUtil_End();
+}
@@ -0,0 +1,127 @@
+#
+# Driver tests: runs the Python driver (scripts/cryptomem.py) against the host device model (test/host/Device.c).
+#
+#   python3 CryptoMemDriverTest.py <path of the cryptomem_device shared library>
+#
+import ctypes
+import hashlib
+import os
+import struct
+import sys
+import unittest
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "scripts"))
+
+from cryptomem import LPC810_CryptoMem
+
+#---------------------------------------------------------------------------------------------------
+# Mock SMBus connected to the host device model
+#
+class HostBus:
+    """
+    SMBus accessor (read_i2c_block_data/write_i2c_block_data) backed by the host device model. Records the
+    (offset, data) of every block write.
+    """
+    def __init__(self, device, i2c_addr = 0x20):
+        self.device   = device
+        self.i2c_addr = i2c_addr
+        self.writes   = []
+
+    def write_i2c_block_data(self, i2c_addr, offset, data):
+        assert i2c_addr == self.i2c_addr
+        assert 0 < len(data) <= 0x20, "SMBus block writes are limited to 32 bytes"
+
+        self.writes.append((int(offset), bytes(data)))
+        self.device.HostDevice_Write(int(offset), bytes(data), len(data))
+
+    def read_i2c_block_data(self, i2c_addr, offset, length):
+        assert i2c_addr == self.i2c_addr
+        assert 0 < length <= 0x20, "SMBus block reads are limited to 32 bytes"
+
+        buffer = ctypes.create_string_buffer(int(length))
+        self.device.HostDevice_Read(int(offset), buffer, int(length))
+        return list(buffer.raw)
+
+    def written(self, offset, length):
+        """
+        Returns the bytes written to a register range (by the most recent writes covering each address).
+        """
+        memory = {}
+        for (start, data) in self.writes:
+            for (i, value) in enumerate(data):
+                memory[start + i] = value
+
+        return bytes(memory.get(address, None) for address in range(offset, offset + length))
+
+#---------------------------------------------------------------------------------------------------
+# Tests
+#
+class DriverTest(unittest.TestCase):
+    device = None
+
+    def setUp(self):
+        DriverTest.device.HostDevice_Reset()
+        self.bus = HostBus(DriverTest.device)
+        self.mem = LPC810_CryptoMem(self.bus)
+
+    def enable_regmap_v2(self, enable):
+        # Rewrite the device configuration page with NV_SYS_CFG[7] (the default device is unlocked)
+        page0 = bytearray(ctypes.string_at(ctypes.addressof(ctypes.c_uint8.in_dll(DriverTest.device, "gNv")), 0x40))
+        page0[4] = (page0[4] | 0x80) if enable else (page0[4] & 0x7F)
+
+        self.mem.io_cmd_checked(opcode=0xF1, arg0=0x5C, data=bytes(page0))
+        DriverTest.device.HostDevice_Reset()
+
+        self.mem.regmap_v2 = bool(enable)
+        self.bus.writes = []
+
+    def test_io_write(self):
+        # Writes longer than one SMBus block are split into consecutive blocks
+        data = bytes(range(0x50))
+        self.mem.io_write(0x00, data)
+
+        self.assertEqual(self.bus.writes, [(0x00, data[0x00:0x20]), (0x20, data[0x20:0x40]), (0x40, data[0x40:0x50])])
+        self.assertEqual(self.mem.io_read(0x00, 0x50), data)
+
+    def test_io_cmd_v2(self):
+        seed = bytes(range(0x40, 0x60))
+        expected = self.mem.hkdf(seed)
+
+        self.enable_regmap_v2(True)
+        try:
+            # The request (DATA, ARG_0-ARG_2 and CMD) goes out as one contiguous write
+            (status_0, status_1, rsp) = self.mem.io_cmd(opcode=0xB0, arg0=len(seed), arg2=0x5A, data=seed, rsp_len=0x20)
+
+            self.assertEqual(self.bus.written(0x00, len(seed)), seed)
+            self.assertEqual(self.bus.written(0x50, 0x04), bytes([len(seed), 0x00, 0x5A, 0xB0]))
+            self.assertEqual((status_0, status_1, rsp), (0xC3, 0x00, expected))
+
+            # Extend carries its data the same way (and matches the default register map)
+            data = bytes(range(0x20))
+            self.mem.extend(1, data)
+            self.assertEqual(self.bus.written(0x50, 0x04), bytes([0x01, len(data), 0x00, 0xE0]))
+        finally:
+            self.enable_regmap_v2(False)
+
+    def test_hkdf_batch(self):
+        seeds = [bytes(range(0x00, 0x20)), bytes(range(0xA0, 0xC0))]
+
+        # Each key of the batch matches the single derivation of its seed
+        keys = self.mem.hkdf_batch(seeds)
+        self.assertEqual(keys, [self.mem.hkdf(seed) for seed in seeds])
+        self.assertNotEqual(keys[0], keys[1])
+
+    def test_measure(self):
+        data = bytes((i * 7 + 3) & 0xFF for i in range(200))
+
+        # Empty, short, exactly one chunk, one chunk plus a byte, and several chunks
+        for length in [0, 1, 0x50, 0x51, 200]:
+            self.assertEqual(self.mem.measure(data[:length], mode=0), hashlib.sha256(data[:length]).digest(), length)
+
+#---------------------------------------------------------------------------------------------------
+if __name__ == "__main__":
+    DriverTest.device = ctypes.CDLL(os.path.abspath(sys.argv.pop(1)))
+    DriverTest.device.HostDevice_Write.argtypes = [ctypes.c_uint8, ctypes.c_char_p, ctypes.c_uint32]
+    DriverTest.device.HostDevice_Read.argtypes = [ctypes.c_uint8, ctypes.c_char_p, ctypes.c_uint32]
+
+    unittest.main()
@@ -0,0 +1,674 @@
+/**
+ * @file
+ * @brief Host tests of the command layer
+ *
+ * The tests drive the command layer through the EEP byte callbacks (like the wired interface does).
+ */
+#include <Config.h>
+#include <Hal.h>
+#include <Eep.h>
+#include <Sha256.h>
+
+#include "TestUtil.h"
+
+// Command layer entry points and NV data (see CryptoMem.c)
+extern void CryptoMem_Init(void);
+extern void CryptoMem_HandleCommand(void);
+extern const uint8_t gNv[];
+
+// Offsets of the command registers (default register map)
+#define REG_ARG_0 UINT8_C(0x50)
+#define REG_ARG_1 UINT8_C(0x51)
+#define REG_ARG_2 UINT8_C(0x52)
+#define REG_CMD   UINT8_C(0x53)
+#define REG_STAT  UINT8_C(0x54)
+#define REG_RET_0 UINT8_C(0x55)
+
+// Offset of the RAM mirror of the NV user data
+#define REG_USER_DATA UINT8_C(0x70)
+
+// Offsets of the volatile bits and locks, and of the counter alias registers
+#define REG_VOLATILE_BITS  UINT8_C(0x58)
+#define REG_VOLATILE_LOCKS UINT8_C(0x5C)
+#define REG_CTR_INC_0      UINT8_C(0x6D)
+
+// Offset of the staging bank status register
+#define REG_STAGE_STAT UINT8_C(0x6C)
+
+// Value of the STAT register when the device is ready (or busy)
+#define STAT_READY UINT8_C(0xC3)
+#define STAT_BUSY  UINT8_C(0xFF)
+
+//---------------------------------------------------------------------------------------------------------------------
+/**
+ * @brief Writes a sequence of registers (like a single write transaction of the wired interface).
+ */
+static void Test_Write(const uint8_t address, const void *const data, const uint32_t size)
+{
+	for (uint32_t i = 0u; i < size; ++i)
+	{
+		Eep_ByteWriteCallback((uint8_t) (address + i), ((const uint8_t *) data)[i]);
+	}
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+/**
+ * @brief Reads a sequence of registers (like a single read transaction of the wired interface).
+ */
+static void Test_Read(const uint8_t address, void *const data, const uint32_t size)
+{
+	uint8_t current = address;
+
+	for (uint32_t i = 0u; i < size; ++i)
+	{
+		((uint8_t *) data)[i] = Eep_ByteReadCallback(current);
+#if (CONFIG_CRYPTOMEM_REGISTER_MAP_V2 != 0)
+		current = Eep_NextReadAddressCallback(current);
+#else
+		current = (uint8_t) (current + 1u);
+#endif
+	}
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+/**
+ * @brief Executes a command (default register map).
+ *
+ * @return Return code (RET_0) of the command.
+ */
+static uint8_t Test_Command(const uint8_t cmd, const uint8_t arg0, const uint8_t arg1, const void *const data, const uint32_t data_len)
+{
+	Test_Write(0x00u, data, data_len);
+
+	const uint8_t request[4u] = { arg0, arg1, 0x00u, cmd };
+	Test_Write(REG_ARG_0, request, sizeof(request));
+
+	CryptoMem_HandleCommand();
+
+	TEST_CHECK(Eep_ByteReadCallback(REG_STAT) == STAT_READY);
+#if (CONFIG_CRYPTOMEM_CLOCK_SCALING != 0)
+	// Completed commands are back at the default clock
+	TEST_CHECK(!Hal_HostIsFastClock());
+#endif
+	return Eep_ByteReadCallback(REG_RET_0);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+/**
+ * @brief Writes the device configuration page (0xF1/0x5C) and restarts the command layer.
+ */
+static void Test_WriteConfigAndRestart(const uint8_t page0[HAL_NV_PAGE_SIZE])
+{
+	TEST_CHECK(Test_Command(0xF1u, 0x5Cu, 0x00u, page0, HAL_NV_PAGE_SIZE) == 0x00u);
+	CryptoMem_Init();
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+/**
+ * @brief Scratch NV page (initially erased)
+ */
+HAL_NV_DATA static uint8_t gTestNvPage[HAL_NV_PAGE_SIZE] = { [0u ... (HAL_NV_PAGE_SIZE - 1u)] = 0xFFu };
+
+//---------------------------------------------------------------------------------------------------------------------
+/**
+ * @brief Writes a NV page and checks its contents and the number of erase and program operations.
+ */
+static void Test_CheckNvWrite(const void *const addr, const uint8_t page[HAL_NV_PAGE_SIZE], const uint32_t erases,
+	const uint32_t programs)
+{
+	Hal_HostNvStats_t *const stats = Hal_HostGetNvStats();
+	const Hal_HostNvStats_t start = *stats;
+
+	TEST_CHECK(Hal_NvWrite(addr, page));
+	TEST_CHECK_MEM(addr, page, HAL_NV_PAGE_SIZE);
+	TEST_CHECK(stats->erases - start.erases == erases);
+	TEST_CHECK(stats->programs - start.programs == programs);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+static void Test_NvWrite(void)
+{
+	uint8_t page[HAL_NV_PAGE_SIZE];
+	TestUtil_Random(page, sizeof(page));
+	page[0u] = 0x00u;
+
+	// Erased page (only 1->0 transitions): program without erase
+	Test_CheckNvWrite(gTestNvPage, page, 0u, 1u);
+
+	// Unchanged page: no flash operations
+	Test_CheckNvWrite(gTestNvPage, page, 0u, 0u);
+
+	// Further 1->0 transitions: program without erase
+	for (uint32_t i = 1u; i < sizeof(page); ++i)
+	{
+		page[i] &= (uint8_t) (0xF0u >> (i % 4u));
+	}
+
+	Test_CheckNvWrite(gTestNvPage, page, 0u, 1u);
+
+	// A single 0->1 transition: erase and program
+	page[0u] = 0x01u;
+	Test_CheckNvWrite(gTestNvPage, page, 1u, 1u);
+
+	// Rewriting the current device configuration does not touch the flash
+	Hal_HostNvStats_t *const stats = Hal_HostGetNvStats();
+	const Hal_HostNvStats_t start = *stats;
+
+	uint8_t page0[HAL_NV_PAGE_SIZE];
+	__builtin_memcpy(page0, &gNv[0u], sizeof(page0));
+	TEST_CHECK(Test_Command(0xF1u, 0x5Cu, 0x00u, page0, sizeof(page0)) == 0x00u);
+	TEST_CHECK((stats->erases == start.erases) && (stats->programs == start.programs));
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+static void Test_QuoteExtraData(void)
+{
+	uint8_t data[80u];
+	TestUtil_Random(data, sizeof(data));
+
+	// Every byte of the extra data is MACed (for all lengths up to the size of the DATA area)
+	for (uint32_t length = 1u; length <= sizeof(data); ++length)
+	{
+		uint8_t quote[2u][SHA256_HASH_LENGTH_BYTES];
+
+		for (uint32_t i = 0u; i < 2u; ++i)
+		{
+			data[length - 1u] ^= (uint8_t) i;
+			TEST_CHECK(Test_Command(0xA0u, 0x87u, (uint8_t) length, data, length) == 0x00u);
+			Test_Read(0x00u, quote[i], sizeof(quote[i]));
+		}
+
+		TEST_CHECK(0 != __builtin_memcmp(quote[0u], quote[1u], sizeof(quote[0u])));
+	}
+
+#if (CONFIG_CRYPTOMEM_NV_COUNTER != 0)
+	// The NV counters are quoted by a separate command (with the same arguments)
+	uint8_t quote[2u][SHA256_HASH_LENGTH_BYTES];
+
+	TEST_CHECK(Test_Command(0xA0u, 0x87u, sizeof(data), data, sizeof(data)) == 0x00u);
+	Test_Read(0x00u, quote[0u], sizeof(quote[0u]));
+	TEST_CHECK(Test_Command(0xA1u, 0x87u, sizeof(data), data, sizeof(data)) == 0x00u);
+	Test_Read(0x00u, quote[1u], sizeof(quote[1u]));
+
+	TEST_CHECK(0 != __builtin_memcmp(quote[0u], quote[1u], sizeof(quote[0u])));
+#else
+	TEST_CHECK(Test_Command(0xA1u, 0x87u, 0u, NULL, 0u) == 0xEFu);
+#endif
+}
+
+#if (CONFIG_CRYPTOMEM_QUOTE_CACHE != 0)
+//---------------------------------------------------------------------------------------------------------------------
+/**
+ * @brief Quotes the complete device state (with extra data) and checks the result against a quote with a fresh prefix.
+ */
+static void Test_QuoteAll(uint8_t quote[SHA256_HASH_LENGTH_BYTES])
+{
+	static const uint8_t extra[4u] = { 0x01u, 0x02u, 0x03u, 0x04u };
+
+	TEST_CHECK(Test_Command(0xA0u, 0xFFu, sizeof(extra), extra, sizeof(extra)) == 0x00u);
+	Test_Read(0x00u, quote, SHA256_HASH_LENGTH_BYTES);
+
+	// Another bitmask replaces the cached prefix (the next quote recomputes it)
+	uint8_t fresh[SHA256_HASH_LENGTH_BYTES];
+	TEST_CHECK(Test_Command(0xA0u, 0x7Fu, 0x00u, NULL, 0u) == 0x00u);
+	TEST_CHECK(Test_Command(0xA0u, 0xFFu, sizeof(extra), extra, sizeof(extra)) == 0x00u);
+	Test_Read(0x00u, fresh, sizeof(fresh));
+	TEST_CHECK_MEM(quote, fresh, sizeof(fresh));
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+static void Test_QuoteCacheInvalidation(void)
+{
+	uint8_t quote[2u][SHA256_HASH_LENGTH_BYTES];
+	Test_QuoteAll(quote[0u]);
+
+	// A repeated quote (from the cached prefix) is unchanged
+	Test_QuoteAll(quote[1u]);
+	TEST_CHECK_MEM(quote[0u], quote[1u], sizeof(quote[0u]));
+
+	// Every change of the device state replaces the cached prefix
+	for (uint32_t change = 0u; change < 6u; ++change)
+	{
+		uint8_t data[HAL_NV_PAGE_SIZE] = { 0u };
+		TestUtil_Random(data, 32u);
+
+		switch (change)
+		{
+		case 0u:
+			// Volatile bits
+			Test_Write(REG_VOLATILE_BITS, data, 4u);
+			break;
+
+		case 1u:
+			// Volatile locks
+			data[0u] |= 0x01u;
+			Test_Write(REG_VOLATILE_LOCKS, data, 1u);
+			break;
+
+		case 2u:
+			// Counter alias
+			data[0u] = 0x01u;
+			Test_Write(REG_CTR_INC_0, data, 1u);
+			break;
+
+		case 3u:
+			// PCR extend
+			TEST_CHECK(Test_Command(0xE0u, 0x00u, 32u, data, 32u) == 0x00u);
+			break;
+
+		case 4u:
+			// NV user data (with the default write password)
+			TEST_CHECK(Test_Command(0xF1u, 0x2Au, 0x00u, data, sizeof(data)) == 0x00u);
+			break;
+
+		default:
+			// Device configuration (new quote key seed)
+			__builtin_memcpy(data, &gNv[0u], sizeof(data));
+			data[0x18u] ^= 0xA5u;
+			TEST_CHECK(Test_Command(0xF1u, 0x5Cu, 0x00u, data, sizeof(data)) == 0x00u);
+			break;
+		}
+
+		Test_QuoteAll(quote[(change + 1u) % 2u]);
+		TEST_CHECK(0 != __builtin_memcmp(quote[0u], quote[1u], sizeof(quote[0u])));
+	}
+
+	// Back to the default configuration
+	uint8_t page0[HAL_NV_PAGE_SIZE];
+	__builtin_memcpy(page0, &gNv[0u], sizeof(page0));
+	page0[0x18u] ^= 0xA5u;
+	Test_WriteConfigAndRestart(page0);
+}
+#endif
+
+#if (CONFIG_CRYPTOMEM_STAGING != 0)
+//---------------------------------------------------------------------------------------------------------------------
+static void Test_StagingBehindQuote(void)
+{
+	uint8_t seed[32u];
+	__builtin_memset(seed, 0xABu, sizeof(seed));
+
+	// Reference results
+	uint8_t expected_quote[SHA256_HASH_LENGTH_BYTES];
+	TEST_CHECK(Test_Command(0xA0u, 0x87u, 0x00u, NULL, 0u) == 0x00u);
+	Test_Read(0x00u, expected_quote, sizeof(expected_quote));
+
+	uint8_t expected_key[SHA256_HASH_LENGTH_BYTES];
+	TEST_CHECK(Test_Command(0xB0u, sizeof(seed), 0x00u, seed, sizeof(seed)) == 0x00u);
+	Test_Read(0x00u, expected_key, sizeof(expected_key));
+
+	// Stage the seed (without a command) while the quote executes
+	const uint8_t quote[4u] = { 0x87u, 0x00u, 0x00u, 0xA0u };
+	Test_Write(REG_ARG_0, quote, sizeof(quote));
+	Test_Write(0x00u, seed, sizeof(seed));
+	TEST_CHECK(Eep_ByteReadCallback(REG_STAGE_STAT) == 0x01u);
+
+	CryptoMem_HandleCommand();
+
+	// The response of the quote is intact (the staged data stays pending)
+	uint8_t response[SHA256_HASH_LENGTH_BYTES];
+	TEST_CHECK(Eep_ByteReadCallback(REG_STAT) == STAT_READY);
+	TEST_CHECK(Eep_ByteReadCallback(REG_RET_0) == 0x00u);
+	Test_Read(0x00u, response, sizeof(response));
+	TEST_CHECK_MEM(response, expected_quote, sizeof(response));
+	TEST_CHECK(Eep_ByteReadCallback(REG_STAGE_STAT) == 0x01u);
+
+	// The next request picks up the staged data
+	const uint8_t hkdf[4u] = { sizeof(seed), 0x00u, 0x00u, 0xB0u };
+	Test_Write(REG_ARG_0, hkdf, sizeof(hkdf));
+	TEST_CHECK(Eep_ByteReadCallback(REG_STAGE_STAT) == 0x00u);
+
+	CryptoMem_HandleCommand();
+
+	TEST_CHECK(Eep_ByteReadCallback(REG_RET_0) == 0x00u);
+	Test_Read(0x00u, response, sizeof(response));
+	TEST_CHECK_MEM(response, expected_key, sizeof(response));
+
+	// A staged command starts right away (the quote response is replaced by the staged request)
+	Test_Write(REG_ARG_0, quote, sizeof(quote));
+	Test_Write(0x00u, seed, sizeof(seed));
+	Test_Write(REG_ARG_0, hkdf, sizeof(hkdf));
+	TEST_CHECK(Eep_ByteReadCallback(REG_STAGE_STAT) == 0x03u);
+
+	CryptoMem_HandleCommand();
+	TEST_CHECK(Eep_ByteReadCallback(REG_STAT) == STAT_BUSY);
+	TEST_CHECK(Eep_ByteReadCallback(REG_STAGE_STAT) == 0x00u);
+
+	CryptoMem_HandleCommand();
+	TEST_CHECK(Eep_ByteReadCallback(REG_STAT) == STAT_READY);
+	TEST_CHECK(Eep_ByteReadCallback(REG_RET_0) == 0x00u);
+	Test_Read(0x00u, response, sizeof(response));
+	TEST_CHECK_MEM(response, expected_key, sizeof(response));
+
+	// A failed command drops the staged command (but keeps the staged data pending)
+	const uint8_t invalid[4u] = { 0xFFu, 0x00u, 0x00u, 0xB0u };
+	Test_Write(REG_ARG_0, invalid, sizeof(invalid));
+	Test_Write(0x00u, seed, sizeof(seed));
+	Test_Write(REG_ARG_0, hkdf, sizeof(hkdf));
+
+	CryptoMem_HandleCommand();
+	TEST_CHECK(Eep_ByteReadCallback(REG_STAT) == STAT_READY);
+	TEST_CHECK(Eep_ByteReadCallback(REG_RET_0) == 0xE1u);
+	TEST_CHECK(Eep_ByteReadCallback(REG_STAGE_STAT) == 0x01u);
+
+	Test_Write(REG_CMD, &hkdf[3u], 1u);
+	CryptoMem_HandleCommand();
+	TEST_CHECK(Eep_ByteReadCallback(REG_RET_0) == 0x00u);
+	Test_Read(0x00u, response, sizeof(response));
+	TEST_CHECK_MEM(response, expected_key, sizeof(response));
+}
+#endif
+
+#if (CONFIG_CRYPTOMEM_NV_LOG_SLOTS != 0)
+//---------------------------------------------------------------------------------------------------------------------
+/**
+ * @brief Writes the NV user data (0xF1/0x2A with the default write password) and returns RET_0.
+ */
+static uint8_t Test_WriteUserData(const uint8_t user_data[32u])
+{
+	uint8_t page[HAL_NV_PAGE_SIZE] = { 0u };
+	__builtin_memcpy(&page[0u], user_data, 32u);
+
+	return Test_Command(0xF1u, 0x2Au, 0x00u, page, sizeof(page));
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+static void Test_NvLogPowerLoss(void)
+{
+	Hal_HostNvStats_t *const stats = Hal_HostGetNvStats();
+
+	uint8_t current[32u];
+	Test_Read(REG_USER_DATA, current, sizeof(current));
+
+	// Interrupt every flash operation of several rounds through both halves of the log
+	for (uint32_t n = 0u; n < 3u * 2u * CONFIG_CRYPTOMEM_NV_LOG_SLOTS; ++n)
+	{
+		uint8_t next[32u];
+		TestUtil_Random(next, sizeof(next));
+
+		for (uint32_t fail = 1u; fail <= CONFIG_CRYPTOMEM_NV_LOG_SLOTS + 2u; ++fail)
+		{
+			stats->fail_countdown = fail;
+			(void) Test_WriteUserData(next);
+			stats->fail_countdown = 0u;
+
+			// After the restart, the user data is either the old or the new value (never a torn record)
+			uint8_t user_data[32u];
+			CryptoMem_Init();
+			Test_Read(REG_USER_DATA, user_data, sizeof(user_data));
+
+			TEST_CHECK((0 == __builtin_memcmp(user_data, current, sizeof(user_data))) ||
+				(0 == __builtin_memcmp(user_data, next, sizeof(user_data))));
+		}
+
+		// Complete the write (without a power loss)
+		TEST_CHECK(Test_WriteUserData(next) == 0x00u);
+		CryptoMem_Init();
+		Test_Read(REG_USER_DATA, current, sizeof(current));
+		TEST_CHECK_MEM(current, next, sizeof(current));
+	}
+}
+#endif
+
+#if (CONFIG_CRYPTOMEM_NV_COUNTER != 0)
+//---------------------------------------------------------------------------------------------------------------------
+/**
+ * @brief Reads (or increments) a NV counter (0xC1) and returns its value (or UINT32_MAX if the command failed).
+ */
+static uint32_t Test_NvCounter(const uint8_t index, const uint8_t operation)
+{
+	if (Test_Command(0xC1u, index, operation, NULL, 0u) != 0x00u)
+	{
+		return UINT32_MAX;
+	}
+
+	uint8_t value[4u];
+	Test_Read((uint8_t) (4u * index), value, sizeof(value));
+	return (uint32_t) value[0u] | ((uint32_t) value[1u] << 8u) | ((uint32_t) value[2u] << 16u) | ((uint32_t) value[3u] << 24u);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+static void Test_NvCounterPowerLoss(void)
+{
+	Hal_HostNvStats_t *const stats = Hal_HostGetNvStats();
+	uint32_t value = Test_NvCounter(1u, 0x00u);
+
+	// Interrupt the first or second flash operation of increments through two rollovers of the unary page
+	for (uint32_t n = 0u; n < 2u * 512u + 64u; ++n)
+	{
+		stats->fail_countdown = 1u + (n % 2u);
+		(void) Test_NvCounter(1u, 0x01u);
+		stats->fail_countdown = 0u;
+
+		// After the restart, the counter has not gone backwards (a torn rollover may skip up to one unary page)
+		CryptoMem_Init();
+		const uint32_t restarted = Test_NvCounter(1u, 0x00u);
+		TEST_CHECK((restarted >= value) && (restarted <= value + 512u));
+
+		// And the next increment (without a power loss) counts by exactly one
+		value = Test_NvCounter(1u, 0x01u);
+		TEST_CHECK(value == restarted + 1u);
+	}
+
+	// A rollover with an interrupted erase of the unary page
+	while ((Test_NvCounter(1u, 0x00u) % 512u) != 0u)
+	{
+		TEST_CHECK(Test_NvCounter(1u, 0x01u) != UINT32_MAX);
+	}
+
+	value = Test_NvCounter(1u, 0x00u);
+	stats->fail_countdown = 2u;
+	TEST_CHECK(Test_Command(0xC1u, 0x01u, 0x01u, NULL, 0u) == 0xE4u);
+	stats->fail_countdown = 0u;
+
+	CryptoMem_Init();
+	const uint32_t restarted = Test_NvCounter(1u, 0x00u);
+	TEST_CHECK(restarted > value);
+
+	for (uint32_t n = 1u; n <= 512u; ++n)
+	{
+		TEST_CHECK(Test_NvCounter(1u, 0x01u) == restarted + n);
+	}
+}
+#endif
+
+#if (CONFIG_CRYPTOMEM_KEY_CACHE == CONFIG_CRYPTOMEM_KEY_CACHE_NV)
+//---------------------------------------------------------------------------------------------------------------------
+/**
+ * @brief Computes a key derivation (0xB0) and a quote (0xA0) with the device keys.
+ */
+static void Test_DeviceKeyResults(const uint8_t seed[32u], uint8_t results[2u][SHA256_HASH_LENGTH_BYTES])
+{
+	TEST_CHECK(Test_Command(0xB0u, 32u, 0x00u, seed, 32u) == 0x00u);
+	Test_Read(0x00u, results[0u], SHA256_HASH_LENGTH_BYTES);
+
+	TEST_CHECK(Test_Command(0xA0u, 0x80u, 32u, seed, 32u) == 0x00u);
+	Test_Read(0x00u, results[1u], SHA256_HASH_LENGTH_BYTES);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+static void Test_KeyStatePowerLoss(void)
+{
+	Hal_HostNvStats_t *const stats = Hal_HostGetNvStats();
+
+	uint8_t seed[32u];
+	TestUtil_Random(seed, sizeof(seed));
+
+	// Two device configurations (with different key seeds)
+	uint8_t pages[2u][HAL_NV_PAGE_SIZE];
+	__builtin_memcpy(pages[0u], &gNv[0u], sizeof(pages[0u]));
+	__builtin_memcpy(pages[1u], &gNv[0u], sizeof(pages[1u]));
+	for (uint32_t i = 0x10u; i < 0x20u; ++i)
+	{
+		pages[1u][i] ^= 0x5Au;
+	}
+
+	uint8_t expected[2u][2u][SHA256_HASH_LENGTH_BYTES];
+	for (uint32_t config = 0u; config < 2u; ++config)
+	{
+		Test_WriteConfigAndRestart(pages[config]);
+		Test_DeviceKeyResults(seed, expected[config]);
+	}
+
+	TEST_CHECK(0 != __builtin_memcmp(expected[0u], expected[1u], sizeof(expected[0u])));
+
+	// Count the flash operations of a configuration write
+	const uint32_t start = stats->erases + stats->programs;
+	Test_WriteConfigAndRestart(pages[0u]);
+	const uint32_t ops = stats->erases + stats->programs - start;
+	uint32_t current = 0u;
+
+	// Interrupt every flash operation of the configuration write (page 0 and the keyed HMAC states)
+	for (uint32_t fail = 1u; fail <= ops; ++fail)
+	{
+		const uint32_t target = current ^ 1u;
+
+		stats->fail_countdown = fail;
+		(void) Test_Command(0xF1u, 0x5Cu, 0x00u, pages[target], HAL_NV_PAGE_SIZE);
+		stats->fail_countdown = 0u;
+
+		if ((0 != __builtin_memcmp(&gNv[0u], pages[target], HAL_NV_PAGE_SIZE)) &&
+			(0 != __builtin_memcmp(&gNv[0u], pages[current], HAL_NV_PAGE_SIZE)))
+		{
+			// Torn configuration page (restore the target configuration directly)
+			TEST_CHECK(Hal_NvWrite(&gNv[0u], pages[target]));
+		}
+
+		// After the restart, the device keys match the configuration page (stale keyed states are not used)
+		CryptoMem_Init();
+		current = (0 == __builtin_memcmp(&gNv[0u], pages[target], HAL_NV_PAGE_SIZE)) ? target : current;
+
+		uint8_t results[2u][SHA256_HASH_LENGTH_BYTES];
+		Test_DeviceKeyResults(seed, results);
+		TEST_CHECK_MEM(results, expected[current], sizeof(results));
+	}
+
+	// Stale keyed states that cannot be rewritten at startup (the device keys are derived instead)
+	uint8_t stale[HAL_NV_PAGE_SIZE];
+	TestUtil_Random(stale, sizeof(stale));
+	TEST_CHECK(Hal_NvWrite(&gNv[2u * HAL_NV_PAGE_SIZE], stale));
+
+	stats->fail_countdown = 1u;
+	CryptoMem_Init();
+	stats->fail_countdown = 0u;
+
+	uint8_t results[2u][SHA256_HASH_LENGTH_BYTES];
+	Test_DeviceKeyResults(seed, results);
+	TEST_CHECK_MEM(results, expected[current], sizeof(results));
+
+	// The next startup repairs the keyed states
+	CryptoMem_Init();
+	TEST_CHECK(0 != __builtin_memcmp(&gNv[2u * HAL_NV_PAGE_SIZE], stale, sizeof(stale)));
+	Test_DeviceKeyResults(seed, results);
+	TEST_CHECK_MEM(results, expected[current], sizeof(results));
+
+	// Back to the default configuration
+	Test_WriteConfigAndRestart(pages[0u]);
+}
+#endif
+
+#if (CONFIG_CRYPTOMEM_REGISTER_MAP_V2 != 0)
+//---------------------------------------------------------------------------------------------------------------------
+static void Test_RegisterMapV2(void)
+{
+	uint8_t seed[32u];
+	TestUtil_Random(seed, sizeof(seed));
+
+	// Reference result (default register map)
+	uint8_t expected[SHA256_HASH_LENGTH_BYTES];
+	TEST_CHECK(Test_Command(0xB0u, sizeof(seed), 0x00u, seed, sizeof(seed)) == 0x00u);
+	Test_Read(0x00u, expected, sizeof(expected));
+
+	// Select the register map v2 (NV_SYS_CFG[7])
+	uint8_t page0[HAL_NV_PAGE_SIZE];
+	__builtin_memcpy(page0, &gNv[0u], sizeof(page0));
+	page0[4u] |= 0x80u;
+	Test_WriteConfigAndRestart(page0);
+
+	// Issue the command with a single write (DATA, ARG_0-ARG_2 and CMD are contiguous)
+	uint8_t request[0x54u] = { 0u };
+	__builtin_memcpy(&request[0u], seed, sizeof(seed));
+	request[0x50u] = sizeof(seed);
+	request[0x51u] = 0x00u;
+	request[0x52u] = 0x5Au;
+	request[0x53u] = 0xB0u;
+	Test_Write(0x00u, request, sizeof(request));
+
+	// The complete command window reads as busy while the command is ongoing
+	uint8_t response[5u + SHA256_HASH_LENGTH_BYTES];
+	Test_Read(0x53u, response, sizeof(response));
+	for (uint32_t i = 0u; i < sizeof(response); ++i)
+	{
+		TEST_CHECK(response[i] == 0xFFu);
+	}
+
+	CryptoMem_HandleCommand();
+
+	// Poll with a single read (STAT, RET_0-RET_2, RSP_LEN, and the response data after the wrap to 0x00)
+	Test_Read(0x53u, response, sizeof(response));
+	TEST_CHECK(response[0u] == STAT_READY);
+	TEST_CHECK(response[1u] == 0x00u);
+	TEST_CHECK(response[2u] == 0x00u);
+	TEST_CHECK(response[3u] == 0x5Au);
+	TEST_CHECK(response[4u] == SHA256_HASH_LENGTH_BYTES);
+	TEST_CHECK_MEM(&response[5u], expected, sizeof(expected));
+
+	// Registers outside of the command window are unchanged
+	uint8_t uid[16u];
+	Test_Read(0xF0u, uid, sizeof(uid));
+	TEST_CHECK(uid[0u] == 0x38u);
+
+	// Back to the default register map
+	page0[4u] &= (uint8_t) ~0x80u;
+	__builtin_memcpy(&request[0u], page0, sizeof(page0));
+	__builtin_memset(&request[sizeof(page0)], 0u, 0x50u - sizeof(page0));
+	request[0x50u] = 0x5Cu;
+	request[0x51u] = 0x00u;
+	request[0x52u] = 0x00u;
+	request[0x53u] = 0xF1u;
+	Test_Write(0x00u, request, sizeof(request));
+	CryptoMem_HandleCommand();
+	Test_Read(0x53u, response, 2u);
+	TEST_CHECK((response[0u] == STAT_READY) && (response[1u] == 0x00u));
+
+	CryptoMem_Init();
+	TEST_CHECK(Eep_ByteReadCallback(REG_STAT) == STAT_READY);
+}
+#endif
+
+//---------------------------------------------------------------------------------------------------------------------
+int main(void)
+{
+	TestUtil_Begin("CryptoMem command layer");
+
+	CryptoMem_Init();
+
+	Test_NvWrite();
+	Test_QuoteExtraData();
+
+#if (CONFIG_CRYPTOMEM_QUOTE_CACHE != 0)
+	Test_QuoteCacheInvalidation();
+#endif
+
+#if (CONFIG_CRYPTOMEM_STAGING != 0)
+	Test_StagingBehindQuote();
+#endif
+
+#if (CONFIG_CRYPTOMEM_REGISTER_MAP_V2 != 0)
+	Test_RegisterMapV2();
+#endif
+
+#if (CONFIG_CRYPTOMEM_NV_LOG_SLOTS != 0)
+	Test_NvLogPowerLoss();
+#endif
+
+#if (CONFIG_CRYPTOMEM_NV_COUNTER != 0)
+	Test_NvCounterPowerLoss();
+#endif
+
+#if (CONFIG_CRYPTOMEM_KEY_CACHE == CONFIG_CRYPTOMEM_KEY_CACHE_NV)
+	Test_KeyStatePowerLoss();
+#endif
+
+	return TestUtil_End();
+}
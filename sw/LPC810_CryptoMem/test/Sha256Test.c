@@ -0,0 +1,406 @@
+/**
+ * @file
+ * @brief Host tests of the SHA-256 module
+ *
+ * The tests compare the SHA-256 module (built with the compression profile selected via CONFIG_SHA256_PROFILE)
+ * against the FIPS 180-4 example vectors and against an independent reference implementation. The aligned
+ * (zero-copy) update path and the specialized extend path are checked against the generic code paths. The
+ * benchmarks report the compression throughput of the selected profile and the cost of the extend paths.
+ */
+#include <Config.h>
+#include <Hal.h>
+#include <Sha256.h>
+
+#include "TestUtil.h"
+
+//---------------------------------------------------------------------------------------------------------------------
+// Reference implementation (straightforward FIPS 180-4 transcription, independent of the module under test)
+//
+
+/**
+ * @brief SHA-256 round constants (reference implementation)
+ */
+static const uint32_t gkRef_K[64u] =
+{
+	UINT32_C(0x428a2f98), UINT32_C(0x71374491), UINT32_C(0xb5c0fbcf), UINT32_C(0xe9b5dba5),
+	UINT32_C(0x3956c25b), UINT32_C(0x59f111f1), UINT32_C(0x923f82a4), UINT32_C(0xab1c5ed5),
+	UINT32_C(0xd807aa98), UINT32_C(0x12835b01), UINT32_C(0x243185be), UINT32_C(0x550c7dc3),
+	UINT32_C(0x72be5d74), UINT32_C(0x80deb1fe), UINT32_C(0x9bdc06a7), UINT32_C(0xc19bf174),
+	UINT32_C(0xe49b69c1), UINT32_C(0xefbe4786), UINT32_C(0x0fc19dc6), UINT32_C(0x240ca1cc),
+	UINT32_C(0x2de92c6f), UINT32_C(0x4a7484aa), UINT32_C(0x5cb0a9dc), UINT32_C(0x76f988da),
+	UINT32_C(0x983e5152), UINT32_C(0xa831c66d), UINT32_C(0xb00327c8), UINT32_C(0xbf597fc7),
+	UINT32_C(0xc6e00bf3), UINT32_C(0xd5a79147), UINT32_C(0x06ca6351), UINT32_C(0x14292967),
+	UINT32_C(0x27b70a85), UINT32_C(0x2e1b2138), UINT32_C(0x4d2c6dfc), UINT32_C(0x53380d13),
+	UINT32_C(0x650a7354), UINT32_C(0x766a0abb), UINT32_C(0x81c2c92e), UINT32_C(0x92722c85),
+	UINT32_C(0xa2bfe8a1), UINT32_C(0xa81a664b), UINT32_C(0xc24b8b70), UINT32_C(0xc76c51a3),
+	UINT32_C(0xd192e819), UINT32_C(0xd6990624), UINT32_C(0xf40e3585), UINT32_C(0x106aa070),
+	UINT32_C(0x19a4c116), UINT32_C(0x1e376c08), UINT32_C(0x2748774c), UINT32_C(0x34b0bcb5),
+	UINT32_C(0x391c0cb3), UINT32_C(0x4ed8aa4a), UINT32_C(0x5b9cca4f), UINT32_C(0x682e6ff3),
+	UINT32_C(0x748f82ee), UINT32_C(0x78a5636f), UINT32_C(0x84c87814), UINT32_C(0x8cc70208),
+	UINT32_C(0x90befffa), UINT32_C(0xa4506ceb), UINT32_C(0xbef9a3f7), UINT32_C(0xc67178f2)
+};
+
+//---------------------------------------------------------------------------------------------------------------------
+static uint32_t Ref_Ror(const uint32_t x, const uint32_t n)
+{
+	return (x >> n) | (x << (32u - n));
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+static void Ref_Compress(uint32_t H[8u], const uint8_t block[64u])
+{
+	uint32_t W[64u];
+	for (uint32_t t = 0u; t < 16u; ++t)
+	{
+		W[t] = ((uint32_t) block[4u * t] << 24u) | ((uint32_t) block[4u * t + 1u] << 16u) |
+			((uint32_t) block[4u * t + 2u] << 8u) | (uint32_t) block[4u * t + 3u];
+	}
+
+	for (uint32_t t = 16u; t < 64u; ++t)
+	{
+		const uint32_t s0 = Ref_Ror(W[t - 15u], 7u) ^ Ref_Ror(W[t - 15u], 18u) ^ (W[t - 15u] >> 3u);
+		const uint32_t s1 = Ref_Ror(W[t - 2u], 17u) ^ Ref_Ror(W[t - 2u], 19u) ^ (W[t - 2u] >> 10u);
+		W[t] = W[t - 16u] + s0 + W[t - 7u] + s1;
+	}
+
+	uint32_t a = H[0u], b = H[1u], c = H[2u], d = H[3u], e = H[4u], f = H[5u], g = H[6u], h = H[7u];
+	for (uint32_t t = 0u; t < 64u; ++t)
+	{
+		const uint32_t T1 = h + (Ref_Ror(e, 6u) ^ Ref_Ror(e, 11u) ^ Ref_Ror(e, 25u)) + ((e & f) ^ (~e & g)) +
+			gkRef_K[t] + W[t];
+		const uint32_t T2 = (Ref_Ror(a, 2u) ^ Ref_Ror(a, 13u) ^ Ref_Ror(a, 22u)) + ((a & b) ^ (a & c) ^ (b & c));
+		h = g; g = f; f = e; e = d + T1;
+		d = c; c = b; b = a; a = T1 + T2;
+	}
+
+	H[0u] += a; H[1u] += b; H[2u] += c; H[3u] += d;
+	H[4u] += e; H[5u] += f; H[6u] += g; H[7u] += h;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+static void Ref_Sha256(uint8_t digest[32u], const uint8_t *const data, const size_t size)
+{
+	uint32_t H[8u] =
+	{
+		UINT32_C(0x6a09e667), UINT32_C(0xbb67ae85), UINT32_C(0x3c6ef372), UINT32_C(0xa54ff53a),
+		UINT32_C(0x510e527f), UINT32_C(0x9b05688c), UINT32_C(0x1f83d9ab), UINT32_C(0x5be0cd19)
+	};
+
+	size_t offset = 0u;
+	for (; (size - offset) >= 64u; offset += 64u)
+	{
+		Ref_Compress(H, &data[offset]);
+	}
+
+	// Padding (one or two final blocks)
+	uint8_t tail[128u] = { 0u };
+	const size_t rest = size - offset;
+	memcpy(tail, &data[offset], rest);
+	tail[rest] = 0x80u;
+
+	const size_t tail_len = (rest < 56u) ? 64u : 128u;
+	const uint64_t bits = (uint64_t) size * 8u;
+	for (uint32_t i = 0u; i < 8u; ++i)
+	{
+		tail[tail_len - 1u - i] = (uint8_t) (bits >> (8u * i));
+	}
+
+	Ref_Compress(H, &tail[0u]);
+	if (tail_len > 64u)
+	{
+		Ref_Compress(H, &tail[64u]);
+	}
+
+	for (uint32_t i = 0u; i < 8u; ++i)
+	{
+		digest[4u * i]      = (uint8_t) (H[i] >> 24u);
+		digest[4u * i + 1u] = (uint8_t) (H[i] >> 16u);
+		digest[4u * i + 2u] = (uint8_t) (H[i] >> 8u);
+		digest[4u * i + 3u] = (uint8_t) H[i];
+	}
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// Tests
+//
+
+/**
+ * @brief FIPS 180-4 (and NIST CAVP) example vector
+ */
+typedef struct
+{
+	const char *message;
+	uint32_t repeat;
+	const char *digest;
+} Sha256TestVector_t;
+
+/**
+ * @brief Example vectors from the FIPS 180-4 examples (and the NIST long message test)
+ */
+static const Sha256TestVector_t gkSha256Vectors[] =
+{
+	{ "", 1u,
+	  "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855" },
+	{ "abc", 1u,
+	  "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" },
+	{ "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 1u,
+	  "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1" },
+	{ "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu", 1u,
+	  "cf5b16a778af8380036ce59e7b0492370b249b11e8f07a51afac45037afee9d1" },
+	{ "a", 1000000u,
+	  "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0" },
+};
+
+//---------------------------------------------------------------------------------------------------------------------
+static void Test_FipsVectors(void)
+{
+	for (size_t n = 0u; n < (sizeof(gkSha256Vectors) / sizeof(gkSha256Vectors[0u])); ++n)
+	{
+		const Sha256TestVector_t *const vector = &gkSha256Vectors[n];
+		const uint32_t length = (uint32_t) strlen(vector->message);
+
+		uint8_t expected[SHA256_HASH_LENGTH_BYTES];
+		TestUtil_ParseHex(expected, vector->digest, sizeof(expected));
+
+		uint8_t digest[SHA256_HASH_LENGTH_BYTES];
+		Sha256_Init();
+		for (uint32_t i = 0u; i < vector->repeat; ++i)
+		{
+			Sha256_Update(vector->message, length);
+		}
+		Sha256_Final(digest);
+
+		TEST_CHECK_MEM(digest, expected, sizeof(expected));
+	}
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+static void Test_RandomLengths(void)
+{
+	static uint8_t message[1024u];
+	TestUtil_Random(message, sizeof(message));
+
+	for (uint32_t length = 0u; length <= 300u; ++length)
+	{
+		uint8_t expected[SHA256_HASH_LENGTH_BYTES];
+		Ref_Sha256(expected, message, length);
+
+		// Single update
+		uint8_t digest[SHA256_HASH_LENGTH_BYTES];
+		Sha256_Init();
+		Sha256_Update(message, length);
+		Sha256_Final(digest);
+		TEST_CHECK_MEM(digest, expected, sizeof(expected));
+
+		// Random split points
+		uint32_t offset = 0u;
+		Sha256_Init();
+		while (offset < length)
+		{
+			const uint32_t chunk = 1u + (TestUtil_RandomWord() % (length - offset));
+			Sha256_Update(&message[offset], chunk);
+			offset += chunk;
+		}
+		Sha256_Final(digest);
+		TEST_CHECK_MEM(digest, expected, sizeof(expected));
+	}
+
+	// Random lengths of longer messages
+	for (uint32_t n = 0u; n < 200u; ++n)
+	{
+		const uint32_t length = TestUtil_RandomWord() % sizeof(message);
+
+		uint8_t expected[SHA256_HASH_LENGTH_BYTES];
+		Ref_Sha256(expected, message, length);
+
+		uint8_t digest[SHA256_HASH_LENGTH_BYTES];
+		Sha256_Init();
+		Sha256_Update(message, length);
+		Sha256_Final(digest);
+		TEST_CHECK_MEM(digest, expected, sizeof(expected));
+	}
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+static void Test_HmacVectors(void)
+{
+	// RFC 4231 test case 2
+	static const uint8_t kKey[] = "Jefe";
+	static const uint8_t kData[] = "what do ya want for nothing?";
+
+	uint8_t expected[SHA256_HASH_LENGTH_BYTES];
+	TestUtil_ParseHex(expected, "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843", sizeof(expected));
+
+	uint8_t mac[SHA256_HASH_LENGTH_BYTES];
+	Sha256_HmacInit(kKey, sizeof(kKey) - 1u);
+	Sha256_HmacUpdate(kData, sizeof(kData) - 1u);
+	Sha256_HmacFinal(mac);
+	TEST_CHECK_MEM(mac, expected, sizeof(expected));
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+static void Test_AlignedUpdate(void)
+{
+	// Word-aligned full blocks take the zero-copy path of Sha256_UpdateCtx, unaligned blocks are copied into the
+	// word buffer first. Both paths must give the same result (the source buffer must stay unchanged).
+	static uint32_t aligned[65u];
+	TestUtil_Random(aligned, sizeof(aligned));
+
+	static uint32_t reference[65u];
+	__builtin_memcpy(reference, aligned, sizeof(reference));
+
+	for (uint32_t length = 0u; length <= 256u; length += 4u)
+	{
+		uint8_t expected[SHA256_HASH_LENGTH_BYTES];
+		Ref_Sha256(expected, (const uint8_t *) aligned, length);
+
+		uint8_t digest[SHA256_HASH_LENGTH_BYTES];
+		Sha256_Init();
+		Sha256_Update(aligned, length);
+		Sha256_Final(digest);
+		TEST_CHECK_MEM(digest, expected, sizeof(expected));
+
+		Ref_Sha256(expected, (const uint8_t *) aligned + 1u, length);
+
+		Sha256_Init();
+		Sha256_Update((const uint8_t *) aligned + 1u, length);
+		Sha256_Final(digest);
+		TEST_CHECK_MEM(digest, expected, sizeof(expected));
+
+		// Aligned blocks after an unaligned (partial) update
+		Ref_Sha256(expected, (const uint8_t *) aligned, length);
+
+		Sha256_Init();
+		Sha256_Update(aligned, length % 64u);
+		Sha256_Update((const uint8_t *) aligned + (length % 64u), length - (length % 64u));
+		Sha256_Final(digest);
+		TEST_CHECK_MEM(digest, expected, sizeof(expected));
+	}
+
+	TEST_CHECK_MEM(aligned, reference, sizeof(reference));
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+static void Test_Extend(void)
+{
+	static uint8_t data[128u];
+	TestUtil_Random(data, sizeof(data));
+
+	for (uint32_t length = 0u; length <= sizeof(data); ++length)
+	{
+		uint8_t initial[SHA256_HASH_LENGTH_BYTES];
+		TestUtil_Random(initial, sizeof(initial));
+
+		// Expected result: SHA-256(digest || data) via the generic update/finalize sequence
+		uint8_t expected[SHA256_HASH_LENGTH_BYTES];
+		Sha256_Init();
+		Sha256_Update(initial, sizeof(initial));
+		Sha256_Update(data, length);
+		Sha256_Final(expected);
+
+		uint8_t digest[SHA256_HASH_LENGTH_BYTES];
+		__builtin_memcpy(digest, initial, sizeof(digest));
+
+		const uint32_t compressions = Sha256_GetCompressionCount();
+		Sha256_Extend(digest, data, length);
+
+		TEST_CHECK_MEM(digest, expected, sizeof(expected));
+
+		// The extend never needs more than the minimum number of blocks for the 32+length byte message
+		const uint32_t blocks = (SHA256_HASH_LENGTH_BYTES + length + 9u + (SHA256_HASH_BLOCK_LENGTH_BYTES - 1u)) /
+			SHA256_HASH_BLOCK_LENGTH_BYTES;
+		TEST_CHECK((Sha256_GetCompressionCount() - compressions) == blocks);
+
+		// The data may also alias the digest (extend with the own value)
+		if (length == SHA256_HASH_LENGTH_BYTES)
+		{
+			Sha256_Init();
+			Sha256_Update(initial, sizeof(initial));
+			Sha256_Update(initial, sizeof(initial));
+			Sha256_Final(expected);
+
+			__builtin_memcpy(digest, initial, sizeof(digest));
+			Sha256_Extend(digest, digest, length);
+			TEST_CHECK_MEM(digest, expected, sizeof(expected));
+		}
+	}
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+static void Bench_Compression(void)
+{
+	static uint32_t message[4096u];
+	TestUtil_Random(message, sizeof(message));
+
+	const uint32_t compressions = Sha256_GetCompressionCount();
+
+	uint8_t digest[SHA256_HASH_LENGTH_BYTES];
+	Hal_StartCycleCounter();
+	for (uint32_t i = 0u; i < 64u; ++i)
+	{
+		Sha256_Init();
+		Sha256_Update(message, sizeof(message));
+		Sha256_Final(digest);
+	}
+	const uint32_t elapsed = Hal_ReadCycleCounter();
+
+	const uint32_t blocks = Sha256_GetCompressionCount() - compressions;
+	TEST_CHECK(blocks == 64u * (sizeof(message) / SHA256_HASH_BLOCK_LENGTH_BYTES + 1u));
+
+	TestUtil_Report("Sha256 compression (per block)", elapsed, blocks, blocks);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+static void Bench_Extend(void)
+{
+	static const uint32_t kLengths[] = { 20u, 32u, 48u };
+	static const char *const kNamesExtend[] = { "Sha256_Extend (20 bytes)", "Sha256_Extend (32 bytes)", "Sha256_Extend (48 bytes)" };
+	static const char *const kNamesGeneric[] = { "Sha256_Update/Final (52 bytes)", "Sha256_Update/Final (64 bytes)", "Sha256_Update/Final (80 bytes)" };
+	const uint32_t kIterations = 10000u;
+
+	uint8_t digest[SHA256_HASH_LENGTH_BYTES] = { 0u };
+	uint8_t data[48u];
+	TestUtil_Random(data, sizeof(data));
+
+	for (uint32_t n = 0u; n < (sizeof(kLengths) / sizeof(kLengths[0u])); ++n)
+	{
+		// Specialized extend path
+		uint32_t compressions = Sha256_GetCompressionCount();
+		Hal_StartCycleCounter();
+		for (uint32_t i = 0u; i < kIterations; ++i)
+		{
+			Sha256_Extend(digest, data, kLengths[n]);
+		}
+		uint32_t elapsed = Hal_ReadCycleCounter();
+		TestUtil_Report(kNamesExtend[n], elapsed, Sha256_GetCompressionCount() - compressions, kIterations);
+
+		// Generic update/finalize sequence for the same message
+		compressions = Sha256_GetCompressionCount();
+		Hal_StartCycleCounter();
+		for (uint32_t i = 0u; i < kIterations; ++i)
+		{
+			Sha256_Init();
+			Sha256_Update(digest, sizeof(digest));
+			Sha256_Update(data, kLengths[n]);
+			Sha256_Final(digest);
+		}
+		elapsed = Hal_ReadCycleCounter();
+		TestUtil_Report(kNamesGeneric[n], elapsed, Sha256_GetCompressionCount() - compressions, kIterations);
+	}
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+int main(void)
+{
+	TestUtil_Begin(CONFIG_SHA256_PROFILE == CONFIG_SHA256_PROFILE_SPEED ? "SHA-256 (speed profile)" : "SHA-256 (size profile)");
+
+	Test_FipsVectors();
+	Test_RandomLengths();
+	Test_HmacVectors();
+	Test_AlignedUpdate();
+	Test_Extend();
+	Bench_Compression();
+	Bench_Extend();
+
+	return TestUtil_End();
+}
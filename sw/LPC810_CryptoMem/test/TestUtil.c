@@ -0,0 +1,87 @@
+/**
+ * @file
+ * @brief Minimal test and benchmark helpers (host build)
+ */
+#include "TestUtil.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * @brief Number of failed checks
+ */
+static uint32_t gTestUtil_Failures;
+
+/**
+ * @brief Number of checks
+ */
+static uint32_t gTestUtil_Checks;
+
+/**
+ * @brief State of the test random number generator (xorshift32)
+ */
+static uint32_t gTestUtil_RandomState = UINT32_C(0x2545F491);
+
+//---------------------------------------------------------------------------------------------------------------------
+void TestUtil_Begin(const char *name)
+{
+	printf("=== %s\n", name);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+int TestUtil_End(void)
+{
+	printf("=== %u checks, %u failures\n", (unsigned) gTestUtil_Checks, (unsigned) gTestUtil_Failures);
+	return (gTestUtil_Failures == 0u) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void TestUtil_Check(bool passed, const char *file, int line, const char *expr)
+{
+	++gTestUtil_Checks;
+
+	if (!passed)
+	{
+		++gTestUtil_Failures;
+		printf("%s:%d: check failed: %s\n", file, line, expr);
+	}
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void TestUtil_ParseHex(uint8_t *dst, const char *hex, size_t size)
+{
+	for (size_t i = 0u; i < size; ++i)
+	{
+		unsigned int value;
+		(void) sscanf(&hex[2u * i], "%2x", &value);
+		dst[i] = (uint8_t) value;
+	}
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+uint32_t TestUtil_RandomWord(void)
+{
+	uint32_t x = gTestUtil_RandomState;
+	x ^= x << 13u;
+	x ^= x >> 17u;
+	x ^= x << 5u;
+	gTestUtil_RandomState = x;
+	return x;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void TestUtil_Random(void *dst, size_t size)
+{
+	uint8_t *const bytes = (uint8_t *) dst;
+	for (size_t i = 0u; i < size; ++i)
+	{
+		bytes[i] = (uint8_t) TestUtil_RandomWord();
+	}
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void TestUtil_Report(const char *name, uint32_t elapsed_ns, uint32_t compressions, uint32_t ops)
+{
+	printf("%-32s %10.1f ns/op %8.2f compressions/op\n", name,
+		(double) elapsed_ns / (double) ops, (double) compressions / (double) ops);
+}
@@ -0,0 +1,69 @@
+/**
+ * @file
+ * @brief Minimal test and benchmark helpers (host build)
+ */
+#ifndef TESTUTIL_H_
+#define TESTUTIL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+/**
+ * @brief Checks a condition (and records a failure if it does not hold).
+ */
+#define TEST_CHECK(cond) \
+	TestUtil_Check((cond), __FILE__, __LINE__, #cond)
+
+/**
+ * @brief Checks that two memory regions are equal.
+ */
+#define TEST_CHECK_MEM(actual, expected, size) \
+	TestUtil_Check(0 == memcmp((actual), (expected), (size)), __FILE__, __LINE__, "memcmp(" #actual ", " #expected ")")
+
+/**
+ * @brief Starts a test program.
+ *
+ * @param[in] name is the name of the test program (printed in the report).
+ */
+extern void TestUtil_Begin(const char *name);
+
+/**
+ * @brief Ends a test program.
+ *
+ * @return Exit code of the test program (zero if all checks passed).
+ */
+extern int TestUtil_End(void);
+
+/**
+ * @brief Records the result of a check.
+ */
+extern void TestUtil_Check(bool passed, const char *file, int line, const char *expr);
+
+/**
+ * @brief Parses a hexadecimal string into a byte buffer.
+ */
+extern void TestUtil_ParseHex(uint8_t *dst, const char *hex, size_t size);
+
+/**
+ * @brief Gets the next word of the (deterministic) test random number generator.
+ */
+extern uint32_t TestUtil_RandomWord(void);
+
+/**
+ * @brief Fills a buffer with (deterministic) random test data.
+ */
+extern void TestUtil_Random(void *dst, size_t size);
+
+/**
+ * @brief Prints a benchmark report line.
+ *
+ * @param[in] name is the name of the benchmarked operation.
+ * @param[in] elapsed_ns is the total time taken by all operations (in nanoseconds).
+ * @param[in] compressions is the total number of SHA-256 compressions of all operations.
+ * @param[in] ops is the number of operations.
+ */
+extern void TestUtil_Report(const char *name, uint32_t elapsed_ns, uint32_t compressions, uint32_t ops);
+
+#endif /* TESTUTIL_H_ */
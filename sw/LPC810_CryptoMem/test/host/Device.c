@@ -0,0 +1,67 @@
+/**
+ * @file
+ * @brief Host device model (command layer behind an emulated I2C register interface)
+ *
+ * The driver tests (CryptoMemDriverTest.py) load this model as a shared library and connect the Python driver to it
+ * through a mock SMBus. Commands execute synchronously when a block write covers the CMD register.
+ */
+#include <Config.h>
+#include <Hal.h>
+#include <Eep.h>
+
+// Command layer entry points (see CryptoMem.c)
+extern void CryptoMem_Init(void);
+extern void CryptoMem_HandleCommand(void);
+
+// CMD register offset (same address in the default register map and the register map v2)
+#define DEVICE_REG_CMD UINT8_C(0x53)
+
+//---------------------------------------------------------------------------------------------------------------------
+/**
+ * @brief Resets the device model (restarts the command layer; the emulated flash is kept).
+ */
+void HostDevice_Reset(void)
+{
+	CryptoMem_Init();
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+/**
+ * @brief Block write (one I2C write transaction).
+ */
+void HostDevice_Write(const uint8_t address, const uint8_t *const data, const uint32_t size)
+{
+	bool command = false;
+
+	for (uint32_t i = 0u; i < size; ++i)
+	{
+		const uint8_t current = (uint8_t) (address + i);
+
+		Eep_ByteWriteCallback(current, data[i]);
+		command = command || (current == DEVICE_REG_CMD);
+	}
+
+	if (command)
+	{
+		CryptoMem_HandleCommand();
+	}
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+/**
+ * @brief Block read (one I2C read transaction).
+ */
+void HostDevice_Read(const uint8_t address, uint8_t *const data, const uint32_t size)
+{
+	uint8_t current = address;
+
+	for (uint32_t i = 0u; i < size; ++i)
+	{
+		data[i] = Eep_ByteReadCallback(current);
+#if (CONFIG_CRYPTOMEM_REGISTER_MAP_V2 != 0)
+		current = Eep_NextReadAddressCallback(current);
+#else
+		current = (uint8_t) (current + 1u);
+#endif
+	}
+}
@@ -0,0 +1,19 @@
+/**
+ * @file
+ * @brief Wired interface stubs (host build for tests and benchmarks)
+ *
+ * The host tests access the I/O memory directly through the EEP byte callbacks of the command layer.
+ */
+#include <Eep.h>
+
+#if (CONFIG_WIRED_IF_TYPE == CONFIG_WIRED_IF_UART)
+//---------------------------------------------------------------------------------------------------------------------
+void Eep_UartStartSlave(void)
+{
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void Eep_UartStopSlave(void)
+{
+}
+#endif
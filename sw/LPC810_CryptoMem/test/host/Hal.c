@@ -0,0 +1,163 @@
+/**
+ * @file
+ * @brief Hardware abstraction layer (host build for tests and benchmarks)
+ */
+#include <Hal.h>
+#include <HalNv.h>
+
+#include <stdlib.h>
+#include <time.h>
+
+/**
+ * @brief Start time of the cycle counter
+ */
+static struct timespec gHal_CycleCounterStart;
+
+/**
+ * @brief Statistics of the emulated flash
+ */
+static Hal_HostNvStats_t gHal_NvStats;
+
+//---------------------------------------------------------------------------------------------------------------------
+HAL_INIT_CODE void Hal_Init(void)
+{
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void Hal_SwitchToExtClock(void)
+{
+}
+
+#if (CONFIG_CRYPTOMEM_CLOCK_SCALING != 0)
+/**
+ * @brief Current clock selection
+ */
+static bool gHal_FastClock;
+
+//---------------------------------------------------------------------------------------------------------------------
+void Hal_SetFastClock(bool fast)
+{
+	gHal_FastClock = fast;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool Hal_HostIsFastClock(void)
+{
+	return gHal_FastClock;
+}
+#endif
+
+//---------------------------------------------------------------------------------------------------------------------
+void Hal_Idle(void)
+{
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+__NO_RETURN void Hal_Halt(void)
+{
+	abort();
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void Hal_SetReadyPin(bool ready)
+{
+	(void) ready;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void Hal_StartCycleCounter(void)
+{
+	clock_gettime(CLOCK_MONOTONIC, &gHal_CycleCounterStart);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+uint32_t Hal_ReadCycleCounter(void)
+{
+	// The host build counts nanoseconds (instead of core clock cycles)
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	const int64_t ns = (int64_t) (now.tv_sec - gHal_CycleCounterStart.tv_sec) * INT64_C(1000000000) +
+		(int64_t) (now.tv_nsec - gHal_CycleCounterStart.tv_nsec);
+
+	return (uint32_t) ns;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+uint32_t Hal_GetIsrCycles(void)
+{
+	// No interrupts on the host
+	return 0u;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void Hal_ReadDeviceID(uint32_t device_id[4])
+{
+	device_id[0u] = UINT32_C(0x16042038);
+	device_id[1u] = UINT32_C(0xAE1B8402);
+	device_id[2u] = UINT32_C(0x51D80DA9);
+	device_id[3u] = UINT32_C(0xF5001903);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+__NO_RETURN void Hal_EnterBootloader(void)
+{
+	abort();
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool Hal_NvErase(const void* addr)
+{
+	if (gHal_NvStats.fail_countdown != 0u)
+	{
+		if (--gHal_NvStats.fail_countdown == 0u)
+		{
+			// Simulated power loss during the erase (the page is left partially erased)
+			__builtin_memset((void *) addr, 0xFF, HAL_NV_PAGE_SIZE / 2u);
+			return false;
+		}
+	}
+
+	// Erased flash reads as all-ones
+	__builtin_memset((void *) addr, 0xFF, HAL_NV_PAGE_SIZE);
+	++gHal_NvStats.erases;
+	return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool Hal_NvProgram(const void* addr, const uint8_t nv_page[HAL_NV_PAGE_SIZE])
+{
+	uint8_t *const dst = (uint8_t *) addr;
+	uint32_t size = HAL_NV_PAGE_SIZE;
+
+	if (gHal_NvStats.fail_countdown != 0u)
+	{
+		if (--gHal_NvStats.fail_countdown == 0u)
+		{
+			// Simulated power loss during programming (only the first quarter of the page is programmed)
+			size = HAL_NV_PAGE_SIZE / 4u;
+		}
+	}
+
+	// Programming can only clear bits
+	for (uint32_t i = 0u; i < size; ++i)
+	{
+		dst[i] &= nv_page[i];
+	}
+
+	++gHal_NvStats.programs;
+	return (size == HAL_NV_PAGE_SIZE);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool Hal_NvWrite(const void* addr, const uint8_t nv_page[HAL_NV_PAGE_SIZE])
+{
+	// Same page update as the target HAL (on top of the emulated erase and program operations)
+	return Hal_NvUpdatePage(addr, nv_page);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+Hal_HostNvStats_t* Hal_HostGetNvStats(void)
+{
+	return &gHal_NvStats;
+}
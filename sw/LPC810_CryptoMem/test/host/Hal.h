@@ -0,0 +1,115 @@
+/**
+ * @file
+ * @brief Hardware abstraction layer (host build for tests and benchmarks)
+ *
+ * This header replaces source/Hal.h in the host build. It provides the subset of the CMSIS intrinsics used by the
+ * portable modules (Sha256.c, CryptoMem.c) and declares the same HAL interface as the target HAL.
+ */
+
+#ifndef HAL_H_
+#define HAL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <Config.h>
+
+// CMSIS compiler and core intrinsics (host equivalents)
+#define __USED                          __attribute__((__used__))
+#define __NO_RETURN                     __attribute__((__noreturn__))
+#define __REV(x)                        __builtin_bswap32(x)
+#define __UNALIGNED_UINT32_READ(p)      Hal_HostUnalignedRead32(p)
+#define __UNALIGNED_UINT32_WRITE(p, v)  Hal_HostUnalignedWrite32((p), (v))
+#define __disable_irq()                 ((void) 0)
+#define __enable_irq()                  ((void) 0)
+#define __get_PRIMASK()                 (0u)
+#define __set_PRIMASK(x)                ((void) (x))
+#define __DMB()                         __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define __DSB()                         __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define __ISB()                         ((void) 0)
+#define __SEV()                         ((void) 0)
+#define __NOP()                         ((void) 0)
+
+static inline uint32_t Hal_HostUnalignedRead32(const void *const p)
+{
+	uint32_t value;
+	__builtin_memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+static inline void Hal_HostUnalignedWrite32(void *const p, const uint32_t value)
+{
+	__builtin_memcpy(p, &value, sizeof(value));
+}
+
+// Default system clock (8 MHz)
+#define HAL_SYSTEM_CLOCK UINT32_C(8000000)
+
+// Fast system clock during command execution (24 MHz PLL output; CONFIG_CRYPTOMEM_CLOCK_SCALING builds only)
+#define HAL_SYSTEM_CLOCK_FAST UINT32_C(24000000)
+
+// No dedicated initialization section on the host
+#define HAL_INIT_CODE
+
+extern HAL_INIT_CODE void Hal_Init(void);
+extern void Hal_SwitchToExtClock(void);
+#if (CONFIG_CRYPTOMEM_CLOCK_SCALING != 0)
+extern void Hal_SetFastClock(bool fast);
+
+// Current clock selection (host build only)
+extern bool Hal_HostIsFastClock(void);
+#endif
+extern void Hal_Idle(void);
+extern __NO_RETURN void Hal_Halt(void);
+
+extern void Hal_SetReadyPin(bool ready);
+
+// Range of the cycle counter (the host build counts nanoseconds)
+#define HAL_CYCLE_COUNTER_MASK UINT32_C(0xFFFFFFFF)
+
+extern void Hal_StartCycleCounter(void);
+extern uint32_t Hal_ReadCycleCounter(void);
+extern uint32_t Hal_GetIsrCycles(void);
+
+extern void Hal_ReadDeviceID(uint32_t device_id[4]);
+extern __NO_RETURN void Hal_EnterBootloader(void);
+
+#define HAL_NV_FLASH_START      (0x00000000u)
+#define HAL_NV_PAGE_SIZE        (64u)
+#define HAL_NV_PAGES_PER_SECTOR (16u)
+#define HAL_NV_NUM_TOTAL_PAGES  (64u)
+
+// NV data lives in a writable section on the host (the emulated flash is programmed with plain stores)
+#define HAL_NV_DATA \
+	__attribute__((__section__(".data.nv"), __used__, __aligned__((HAL_NV_PAGE_SIZE))))
+
+extern bool Hal_NvErase(const void* addr);
+extern bool Hal_NvProgram(const void* addr, const uint8_t nv_page[HAL_NV_PAGE_SIZE]);
+extern bool Hal_NvWrite(const void* addr, const uint8_t nv_page[HAL_NV_PAGE_SIZE]);
+
+/**
+ * @brief Statistics (and fault injection) of the emulated flash (host build only)
+ */
+typedef struct
+{
+	/**
+	 * @brief Number of completed page erases
+	 */
+	uint32_t erases;
+
+	/**
+	 * @brief Number of page programming operations
+	 */
+	uint32_t programs;
+
+	/**
+	 * @brief Simulates a power loss during the n-th next erase or program operation (zero to disable)
+	 */
+	uint32_t fail_countdown;
+} Hal_HostNvStats_t;
+
+extern Hal_HostNvStats_t* Hal_HostGetNvStats(void);
+
+#endif /* HAL_H_ */